@@ -0,0 +1,481 @@
+#include "AgentSimulation.h"
+#include "PathRequestQueue.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Async/ParallelFor.h"
+#include "Engine/World.h"
+
+/* Agents per ParallelFor task */
+static const int32 AgentChunkSize = 256;
+
+/* How far from a demoted actor to look for the node it is standing on */
+static const float DemoteSearchRadius = 500.0f;
+
+int32 FAgentRecords::Add(int32 id, int32 node, float speed)
+{
+	Ids.Add(id);
+	Node.Add(node);
+	Paths.AddDefaulted();
+	Cursor.Add(0);
+	Progress.Add(0.0f);
+	Speed.Add(speed);
+	State.Add(EAgentState::Idle);
+	PathRequest.Add(INDEX_NONE);
+	Transforms.Add(FTransform::Identity);
+	Moved.Add(false);
+	Arrived.Add(false);
+
+	return Ids.Num() - 1;
+}
+
+void FAgentRecords::RemoveAtSwap(int32 index)
+{
+	Ids.RemoveAtSwap(index, 1, false);
+	Node.RemoveAtSwap(index, 1, false);
+	Paths.RemoveAtSwap(index, 1, false);
+	Cursor.RemoveAtSwap(index, 1, false);
+	Progress.RemoveAtSwap(index, 1, false);
+	Speed.RemoveAtSwap(index, 1, false);
+	State.RemoveAtSwap(index, 1, false);
+	PathRequest.RemoveAtSwap(index, 1, false);
+	Transforms.RemoveAtSwap(index, 1, false);
+	Moved.RemoveAtSwap(index, 1, false);
+	Arrived.RemoveAtSwap(index, 1, false);
+}
+
+AAgentSimulation::AAgentSimulation()
+	: Graph(NULL), PathQueue(NULL), NextId(0)
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	Instances = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("Instances"));
+	Instances->SetMobility(EComponentMobility::Movable);
+
+	// Only traces for picking agents, a blocking body per instance would be teleported and rebuild navigation every frame
+	Instances->SetCollisionEnabled(ECollisionEnabled::QueryOnly);
+	Instances->SetCollisionResponseToAllChannels(ECR_Ignore);
+	Instances->SetCollisionResponseToChannel(ECC_Visibility, ECR_Block);
+	Instances->SetCanEverAffectNavigation(false);
+	RootComponent = Instances;
+}
+
+void AAgentSimulation::Initialise(UNodeGraph* graph, FTransform graphTransform, UPathRequestQueue* queue)
+{
+	Graph = graph;
+	GraphTransform = graphTransform;
+	PathQueue = queue;
+
+	if (!PathQueue && Graph)
+	{
+		PathQueue = NewObject<UPathRequestQueue>(this);
+		PathQueue->Initialise(Graph);
+	}
+}
+
+int AAgentSimulation::SpawnAgent(int node, float speed)
+{
+	auto snapshot = Graph ? Graph->GetSnapshot() : FNodeGraphSnapshotPtr();
+
+	if (!snapshot.IsValid() || !snapshot->Topology->IsValidNode(node))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Can't spawn an agent on node %d"), node);
+		return -1;
+	}
+
+	int32 id = NextId++;
+	int32 index = Agents.Add(id, node, speed);
+	Indices.Add(id, index);
+
+	// Places the agent on its node without moving it
+	Agents.State[index] = EAgentState::Moving;
+	AdvanceAgent(index, 0.0f, *snapshot->Topology);
+
+	AddInstance(index);
+
+	return id;
+}
+
+void AAgentSimulation::SpawnAgents(const TArray<int>& nodes, float speed, TArray<int>& ids)
+{
+	ids.Reserve(ids.Num() + nodes.Num());
+
+	for (int node : nodes)
+	{
+		int id = SpawnAgent(node, speed);
+
+		if (id >= 0)
+			ids.Add(id);
+	}
+}
+
+bool AAgentSimulation::RemoveAgent(int id)
+{
+	int32 index;
+
+	if (!Indices.RemoveAndCopyValue(id, index))
+		return false;
+
+	CancelPathRequest(index);
+
+	AActor* actor = NULL;
+
+	if (PromotedActors.RemoveAndCopyValue(id, actor) && actor)
+		actor->Destroy();
+
+	int32 last = Agents.Num() - 1;
+
+	Agents.RemoveAtSwap(index);
+
+	// Mirror the swap on the instances so agent and instance indices stay equal
+	if (index != last)
+	{
+		Indices[Agents.Ids[index]] = index;
+		Instances->UpdateInstanceTransform(index, GetInstanceTransform(index), true, false, true);
+	}
+
+	Instances->RemoveInstance(last);
+
+	OnAgentRemoved.Broadcast(id);
+
+	return true;
+}
+
+bool AAgentSimulation::MoveAgent(int id, int goal, int priority)
+{
+	const int32* index = Indices.Find(id);
+
+	if (!index || !PathQueue || Agents.State[*index] == EAgentState::Promoted)
+		return false;
+
+	int32 i = *index;
+	CancelPathRequest(i);
+
+	// Finish the current edge and plan from its end, the new path picks up from there
+	int32 start = Agents.Node[i];
+	TArray<int32>& path = Agents.Paths[i];
+
+	if (Agents.Cursor[i] < path.Num())
+	{
+		path.SetNum(Agents.Cursor[i] + 1, false);
+		start = path.Last();
+	}
+
+	TWeakObjectPtr<AAgentSimulation> weakThis(this);
+
+	Agents.PathRequest[i] = PathQueue->SubmitNative(start, goal, priority, [weakThis, id](int32 handle, bool success, const TArray<int32>& result)
+	{
+		if (weakThis.IsValid())
+			weakThis->OnPathComplete(id, handle, success, result);
+	});
+
+	return true;
+}
+
+void AAgentSimulation::StopAgent(int id)
+{
+	const int32* index = Indices.Find(id);
+
+	if (!index)
+		return;
+
+	CancelPathRequest(*index);
+
+	TArray<int32>& path = Agents.Paths[*index];
+
+	if (Agents.Cursor[*index] < path.Num())
+		path.SetNum(Agents.Cursor[*index] + 1, false);
+}
+
+void AAgentSimulation::CancelPathRequest(int32 index)
+{
+	if (Agents.PathRequest[index] != INDEX_NONE && PathQueue)
+		PathQueue->Cancel(Agents.PathRequest[index]);
+
+	Agents.PathRequest[index] = INDEX_NONE;
+}
+
+void AAgentSimulation::OnPathComplete(int32 id, int32 request, bool success, const TArray<int32>& path)
+{
+	const int32* index = Indices.Find(id);
+
+	if (!index || Agents.PathRequest[*index] != request)
+		return;
+
+	int32 i = *index;
+	Agents.PathRequest[i] = INDEX_NONE;
+
+	if (!success || path.Num() == 0)
+	{
+		OnAgentPathFailed.Broadcast(id);
+		return;
+	}
+
+	TArray<int32>& current = Agents.Paths[i];
+	int32 cursor = Agents.Cursor[i];
+
+	if (cursor < current.Num() && current[cursor] == path[0])
+	{
+		// Still on the edge towards the start of the new path, keep going along it
+		Agents.Cursor[i] = 0;
+	}
+	else
+	{
+		Agents.Node[i] = path[0];
+		Agents.Cursor[i] = 1;
+		Agents.Progress[i] = 0.0f;
+	}
+
+	current = path;
+
+	if (Agents.Cursor[i] < current.Num())
+		Agents.State[i] = EAgentState::Moving;
+	else
+		OnAgentArrived.Broadcast(id);
+}
+
+void AAgentSimulation::AdvanceAgent(int32 index, float dt, const FNodeGraphTopology& topology)
+{
+	Agents.Moved[index] = false;
+	Agents.Arrived[index] = false;
+
+	if (Agents.State[index] != EAgentState::Moving || !topology.IsValidNode(Agents.Node[index]))
+		return;
+
+	TArray<int32>& path = Agents.Paths[index];
+	int32& node = Agents.Node[index];
+	int32& cursor = Agents.Cursor[index];
+	float& progress = Agents.Progress[index];
+	float distance = Agents.Speed[index] * dt;
+
+	while (cursor < path.Num())
+	{
+		int32 next = path[cursor];
+
+		if (!topology.IsValidNode(next))
+		{
+			cursor = path.Num();
+			break;
+		}
+
+		float length = FVector::Dist(topology.Positions[node], topology.Positions[next]);
+		float remaining = (1.0f - progress) * length;
+
+		if (distance < remaining)
+		{
+			progress += distance / length;
+			break;
+		}
+
+		distance -= remaining;
+		node = next;
+		progress = 0.0f;
+		++cursor;
+	}
+
+	int32 to = node;
+
+	if (cursor < path.Num())
+	{
+		to = path[cursor];
+	}
+	else
+	{
+		// Agents waiting on a replacement path aren't done yet
+		Agents.State[index] = EAgentState::Idle;
+		Agents.Arrived[index] = Agents.PathRequest[index] == INDEX_NONE;
+		path.Reset();
+		cursor = 0;
+	}
+
+	const FVector& a = topology.Positions[node];
+	const FVector& b = topology.Positions[to];
+
+	FVector up = FMath::Lerp(topology.Normals[node], topology.Normals[to], progress).GetSafeNormal(SMALL_NUMBER, FVector::UpVector);
+	FVector forward = b - a;
+
+	if (forward.IsNearlyZero())
+		forward = Agents.Transforms[index].GetRotation().GetForwardVector();
+
+	// Stand on the surface, facing along the edge
+	FQuat rotation = FRotationMatrix::MakeFromZX(up, forward).ToQuat();
+
+	Agents.Transforms[index] = FTransform(rotation, FMath::Lerp(a, b, progress));
+	Agents.Moved[index] = true;
+}
+
+void AAgentSimulation::Tick(float dt)
+{
+	Super::Tick(dt);
+
+	if (!Graph || Agents.Num() == 0)
+		return;
+
+	auto snapshot = Graph->GetSnapshot();
+
+	if (!snapshot.IsValid())
+		return;
+
+	const FNodeGraphTopology& topology = *snapshot->Topology;
+	const int32 numChunks = FMath::DivideAndRoundUp(Agents.Num(), AgentChunkSize);
+
+	ParallelFor(numChunks, [&](int32 chunk)
+	{
+		const int32 end = FMath::Min((chunk + 1) * AgentChunkSize, Agents.Num());
+
+		for (int32 i = chunk * AgentChunkSize; i < end; ++i)
+			AdvanceAgent(i, dt, topology);
+	});
+
+	bool dirty = false;
+	TArray<int32> arrived;
+
+	for (int32 i = 0; i < Agents.Num(); ++i)
+	{
+		if (Agents.Moved[i])
+		{
+			Instances->UpdateInstanceTransform(i, Agents.Transforms[i] * GraphTransform, true, false, true);
+			dirty = true;
+		}
+
+		if (Agents.Arrived[i])
+			arrived.Add(Agents.Ids[i]);
+	}
+
+	// One render state update for every moved instance
+	if (dirty)
+		Instances->MarkRenderStateDirty();
+
+	// Listeners may move or remove agents, so only call them once the batch is done
+	for (int32 id : arrived)
+		OnAgentArrived.Broadcast(id);
+}
+
+FTransform AAgentSimulation::GetInstanceTransform(int32 index) const
+{
+	FTransform transform = Agents.Transforms[index] * GraphTransform;
+
+	// Promoted agents keep their instance slot, drawn at zero scale
+	if (Agents.State[index] == EAgentState::Promoted)
+		transform.SetScale3D(FVector::ZeroVector);
+
+	return transform;
+}
+
+void AAgentSimulation::AddInstance(int32 index)
+{
+	Instances->AddInstanceWorldSpace(GetInstanceTransform(index));
+}
+
+AActor* AAgentSimulation::PromoteAgent(int id)
+{
+	const int32* index = Indices.Find(id);
+
+	if (!index)
+		return NULL;
+
+	int32 i = *index;
+
+	if (Agents.State[i] == EAgentState::Promoted)
+		return PromotedActors.FindRef(id);
+
+	if (!AgentClass)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("AgentSimulation has no AgentClass to promote agents to"));
+		return NULL;
+	}
+
+	FActorSpawnParameters params;
+	params.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	AActor* actor = GetWorld()->SpawnActor<AActor>(AgentClass, Agents.Transforms[i] * GraphTransform, params);
+
+	if (!actor)
+		return NULL;
+
+	CancelPathRequest(i);
+
+	Agents.State[i] = EAgentState::Promoted;
+	Agents.Paths[i].Reset();
+	Agents.Cursor[i] = 0;
+	PromotedActors.Add(id, actor);
+
+	Instances->UpdateInstanceTransform(i, GetInstanceTransform(i), true, true, true);
+
+	return actor;
+}
+
+bool AAgentSimulation::DemoteAgent(int id)
+{
+	const int32* index = Indices.Find(id);
+
+	if (!index || Agents.State[*index] != EAgentState::Promoted)
+		return false;
+
+	int32 i = *index;
+	AActor* actor = NULL;
+
+	PromotedActors.RemoveAndCopyValue(id, actor);
+
+	if (actor && Graph)
+	{
+		int node = Agents.Node[i];
+		FVector vertex;
+
+		Graph->GetClosestNode(node, vertex, GraphTransform.InverseTransformPosition(actor->GetActorLocation()), DemoteSearchRadius);
+		Agents.Node[i] = node;
+	}
+
+	if (actor)
+		actor->Destroy();
+
+	Agents.Progress[i] = 0.0f;
+	Agents.State[i] = EAgentState::Moving;
+
+	// Snaps the agent onto its node and shows its instance again on the next update
+	auto snapshot = Graph ? Graph->GetSnapshot() : FNodeGraphSnapshotPtr();
+
+	if (snapshot.IsValid())
+		AdvanceAgent(i, 0.0f, *snapshot->Topology);
+
+	Agents.State[i] = EAgentState::Idle;
+	Instances->UpdateInstanceTransform(i, GetInstanceTransform(i), true, true, true);
+
+	return true;
+}
+
+AActor* AAgentSimulation::GetPromotedActor(int id) const
+{
+	return PromotedActors.FindRef(id);
+}
+
+int AAgentSimulation::GetAgentFromHit(UPrimitiveComponent* component, int item) const
+{
+	if (component != Instances || !Agents.Ids.IsValidIndex(item))
+		return -1;
+
+	return Agents.Ids[item];
+}
+
+EAgentState AAgentSimulation::GetAgentState(int id) const
+{
+	const int32* index = Indices.Find(id);
+	return index ? Agents.State[*index] : EAgentState::Idle;
+}
+
+int AAgentSimulation::GetAgentNode(int id) const
+{
+	const int32* index = Indices.Find(id);
+	return index ? Agents.Node[*index] : -1;
+}
+
+bool AAgentSimulation::GetAgentTransform(int id, FTransform& transform) const
+{
+	const int32* index = Indices.Find(id);
+
+	if (!index)
+		return false;
+
+	AActor* actor = PromotedActors.FindRef(id);
+	transform = actor ? actor->GetActorTransform() : Agents.Transforms[*index] * GraphTransform;
+
+	return true;
+}
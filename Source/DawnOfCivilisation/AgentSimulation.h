@@ -0,0 +1,149 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "NodeGraph.h"
+#include "AgentSimulation.generated.h"
+
+class UInstancedStaticMeshComponent;
+class UPathRequestQueue;
+
+UENUM(BlueprintType)
+enum class EAgentState : uint8
+{
+	Idle		 UMETA(DisplayName = "Idle"),
+	Moving		 UMETA(DisplayName = "Moving"),
+	Promoted	 UMETA(DisplayName = "Promoted")
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnAgentEvent, int, Agent);
+
+/**
+ * Agents stored as parallel arrays so the batched update walks each field
+ * contiguously. An agent travels from Node towards Paths[Cursor], Progress
+ * is how far along that edge it is in [0, 1].
+ */
+struct FAgentRecords
+{
+	TArray<int32> Ids;
+	TArray<int32> Node;
+	TArray<TArray<int32>> Paths;
+	TArray<int32> Cursor;
+	TArray<float> Progress;
+	TArray<float> Speed;
+	TArray<EAgentState> State;
+	TArray<int32> PathRequest;
+	TArray<FTransform> Transforms;
+
+	/* Written by the batched update, read back on the game thread */
+	TArray<bool> Moved;
+	TArray<bool> Arrived;
+
+	int32 Num() const { return Ids.Num(); }
+
+	int32 Add(int32 id, int32 node, float speed);
+	void RemoveAtSwap(int32 index);
+};
+
+/**
+ * Moves thousands of aliens along UNodeGraph paths without an actor each.
+ * Agents are advanced in parallel batches and drawn as one instanced mesh,
+ * a real actor is only spawned for agents that are promoted (selected or
+ * interacting) and handed back to the simulation when demoted.
+ */
+UCLASS()
+class DAWNOFCIVILISATION_API AAgentSimulation : public AActor
+{
+	GENERATED_BODY()
+
+	public:
+		AAgentSimulation();
+
+		virtual void Tick(float dt) override;
+
+		/* Graph positions are mapped to the world with graphTransform, a queue is created if none is given */
+		UFUNCTION(BlueprintCallable)
+		void Initialise(UNodeGraph* graph, FTransform graphTransform, UPathRequestQueue* queue = NULL);
+
+		UFUNCTION(BlueprintCallable)
+		int SpawnAgent(int node, float speed = 100.0f);
+
+		UFUNCTION(BlueprintCallable)
+		void SpawnAgents(const TArray<int>& nodes, float speed, TArray<int>& ids);
+
+		UFUNCTION(BlueprintCallable)
+		bool RemoveAgent(int id);
+
+		/* Queues a path to goal, the agent finishes its current edge and waits there for it */
+		UFUNCTION(BlueprintCallable)
+		bool MoveAgent(int id, int goal, int priority = 0);
+
+		UFUNCTION(BlueprintCallable)
+		void StopAgent(int id);
+
+		/* Spawns AgentClass in place of the agent's instance, the simulation leaves it alone until demoted */
+		UFUNCTION(BlueprintCallable)
+		AActor* PromoteAgent(int id);
+
+		/* Destroys the promoted actor and resumes simulating from the node closest to where it was left */
+		UFUNCTION(BlueprintCallable)
+		bool DemoteAgent(int id);
+
+		UFUNCTION(BlueprintCallable)
+		AActor* GetPromotedActor(int id) const;
+
+		/* Id of the agent behind a trace hit on the instanced mesh, -1 if it isn't one */
+		UFUNCTION(BlueprintCallable)
+		int GetAgentFromHit(UPrimitiveComponent* component, int item) const;
+
+		UFUNCTION(BlueprintCallable)
+		EAgentState GetAgentState(int id) const;
+
+		UFUNCTION(BlueprintCallable)
+		int GetAgentNode(int id) const;
+
+		UFUNCTION(BlueprintCallable)
+		bool GetAgentTransform(int id, FTransform& transform) const;
+
+		UFUNCTION(BlueprintCallable)
+		int GetNumAgents() const { return Agents.Num(); }
+
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Agents")
+		TSubclassOf<AActor> AgentClass;
+
+		UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Agents")
+		UInstancedStaticMeshComponent* Instances;
+
+		UPROPERTY(BlueprintAssignable)
+		FOnAgentEvent OnAgentArrived;
+
+		UPROPERTY(BlueprintAssignable)
+		FOnAgentEvent OnAgentPathFailed;
+
+		/* Broadcast after the agent is gone, its id is no longer valid */
+		UPROPERTY(BlueprintAssignable)
+		FOnAgentEvent OnAgentRemoved;
+
+	private:
+		void AdvanceAgent(int32 index, float dt, const FNodeGraphTopology& topology);
+		void OnPathComplete(int32 id, int32 request, bool success, const TArray<int32>& path);
+		void CancelPathRequest(int32 index);
+		void AddInstance(int32 index);
+		FTransform GetInstanceTransform(int32 index) const;
+
+		UPROPERTY()
+		UNodeGraph* Graph;
+
+		UPROPERTY()
+		UPathRequestQueue* PathQueue;
+
+		UPROPERTY()
+		TMap<int, AActor*> PromotedActors;
+
+		FTransform GraphTransform;
+
+		/* Agent index == instance index, removals are mirrored on both */
+		FAgentRecords Agents;
+		TMap<int32, int32> Indices;
+		int32 NextId;
+};
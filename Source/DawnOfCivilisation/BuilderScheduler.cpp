@@ -0,0 +1,438 @@
+#include "BuilderScheduler.h"
+#include "AgentSimulation.h"
+#include "Building.h"
+#include "NodeGraph.h"
+#include "NodeGraphSnapshot.h"
+#include "Async/ParallelFor.h"
+#include "HAL/PlatformTime.h"
+
+/* Cost of a builder that can't reach the job, large enough that the solver only picks it when it must */
+static const double UnreachableCost = 1e12;
+
+/* Rings searched around a covered site for a node builders can stand on */
+static const int32 MaxSiteSearchDepth = 8;
+
+/**
+ * Hungarian algorithm with potentials, O(rows^2 * cols). cost is rows x cols
+ * with rows <= cols; rowToCol receives the column chosen for every row.
+ */
+static void SolveAssignment(const TArray<double>& cost, int32 rows, int32 cols, TArray<int32>& rowToCol)
+{
+	check(rows <= cols);
+
+	TArray<double> u, v, minV;
+	TArray<int32> p, way;
+	TArray<bool> used;
+
+	u.Init(0.0, rows + 1);
+	v.Init(0.0, cols + 1);
+	p.Init(0, cols + 1);
+	way.Init(0, cols + 1);
+
+	// Index 0 is the virtual column the augmenting path starts from
+	for (int32 i = 1; i <= rows; ++i)
+	{
+		p[0] = i;
+		int32 j0 = 0;
+
+		minV.Init(TNumericLimits<double>::Max(), cols + 1);
+		used.Init(false, cols + 1);
+
+		do
+		{
+			used[j0] = true;
+
+			int32 i0 = p[j0];
+			int32 j1 = 0;
+			double delta = TNumericLimits<double>::Max();
+
+			for (int32 j = 1; j <= cols; ++j)
+			{
+				if (used[j])
+					continue;
+
+				double current = cost[(i0 - 1) * cols + (j - 1)] - u[i0] - v[j];
+
+				if (current < minV[j])
+				{
+					minV[j] = current;
+					way[j] = j0;
+				}
+
+				if (minV[j] < delta)
+				{
+					delta = minV[j];
+					j1 = j;
+				}
+			}
+
+			for (int32 j = 0; j <= cols; ++j)
+			{
+				if (used[j])
+				{
+					u[p[j]] += delta;
+					v[j] -= delta;
+				}
+				else
+				{
+					minV[j] -= delta;
+				}
+			}
+
+			j0 = j1;
+		}
+		while (p[j0] != 0);
+
+		// Flip the augmenting path
+		do
+		{
+			int32 j1 = way[j0];
+			p[j0] = p[j1];
+			j0 = j1;
+		}
+		while (j0 != 0);
+	}
+
+	rowToCol.Init(INDEX_NONE, rows);
+
+	for (int32 j = 1; j <= cols; ++j)
+	{
+		if (p[j] != 0)
+			rowToCol[p[j] - 1] = j - 1;
+	}
+}
+
+/* The site itself, or the passable node closest to it when a placed building covers it */
+static int32 ResolveSiteNode(const FNodeGraphSnapshot& snapshot, int32 site)
+{
+	const FNodeGraphTopology& topology = *snapshot.Topology;
+
+	if (!topology.IsValidNode(site))
+		return INDEX_NONE;
+
+	if (snapshot.IsPassable(site))
+		return site;
+
+	TSet<int32> visited = { site };
+	TArray<int32> ring = { site }, nextRing;
+
+	for (int32 depth = 0; depth < MaxSiteSearchDepth && ring.Num() > 0; ++depth)
+	{
+		int32 best = INDEX_NONE;
+		float bestDist = MAX_flt;
+
+		nextRing.Reset();
+
+		for (int32 node : ring)
+		{
+			for (int32 child : topology.GetNeighbours(node))
+			{
+				if (visited.Contains(child))
+					continue;
+
+				visited.Add(child);
+				nextRing.Add(child);
+
+				float d = FVector::DistSquared(topology.Positions[child], topology.Positions[site]);
+
+				if (snapshot.IsPassable(child) && d < bestDist)
+					best = child, bestDist = d;
+			}
+		}
+
+		if (best != INDEX_NONE)
+			return best;
+
+		Swap(ring, nextRing);
+	}
+
+	return INDEX_NONE;
+}
+
+UBuilderScheduler::UBuilderScheduler()
+	: ScheduleInterval(0.5f), MaxBatchSize(128), PathPriority(1), Graph(NULL), Agents(NULL), NextJobId(0),
+	  TimeSinceSchedule(0.0f), NumSolves(0), SolveTimeTotal(0.0), LatencyTotal(0.0)
+{
+}
+
+void UBuilderScheduler::Initialise(UNodeGraph* graph, AAgentSimulation* agents)
+{
+	if (Agents)
+	{
+		Agents->OnAgentPathFailed.RemoveDynamic(this, &UBuilderScheduler::OnAgentPathFailed);
+		Agents->OnAgentRemoved.RemoveDynamic(this, &UBuilderScheduler::OnAgentRemoved);
+	}
+
+	Graph = graph;
+	Agents = agents;
+
+	// Assignments are made when the path is requested, these undo the ones that never arrive
+	if (Agents)
+	{
+		Agents->OnAgentPathFailed.AddUniqueDynamic(this, &UBuilderScheduler::OnAgentPathFailed);
+		Agents->OnAgentRemoved.AddUniqueDynamic(this, &UBuilderScheduler::OnAgentRemoved);
+	}
+}
+
+void UBuilderScheduler::OnAgentPathFailed(int agent)
+{
+	ReleaseBuilder(agent);
+}
+
+void UBuilderScheduler::OnAgentRemoved(int agent)
+{
+	RemoveBuilder(agent);
+}
+
+int UBuilderScheduler::AddJob(int node, int buildersRequired)
+{
+	if (buildersRequired <= 0)
+		return -1;
+
+	int32 id = NextJobId++;
+
+	FBuilderJob& job = Jobs.Add(id);
+	job.Node = node;
+	job.Required = buildersRequired;
+	job.PostTime = FPlatformTime::Seconds();
+	job.WarnedUnreachable = false;
+
+	return id;
+}
+
+int UBuilderScheduler::AddBuildingJob(AActor* building, int node)
+{
+	if (!building || !building->Implements<UBuilding>())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s isn't a building"), building ? *building->GetName() : TEXT("None"));
+		return -1;
+	}
+
+	return AddJob(node, IBuilding::Execute_GetNumBuildersRequired(building));
+}
+
+bool UBuilderScheduler::RemoveJob(int job)
+{
+	FBuilderJob removed;
+
+	if (!Jobs.RemoveAndCopyValue(job, removed))
+		return false;
+
+	for (int32 agent : removed.Builders)
+	{
+		if (int32* assigned = Builders.Find(agent))
+			*assigned = INDEX_NONE;
+	}
+
+	return true;
+}
+
+void UBuilderScheduler::AddBuilder(int agent)
+{
+	if (!Builders.Contains(agent))
+		Builders.Add(agent, INDEX_NONE);
+}
+
+void UBuilderScheduler::RemoveBuilder(int agent)
+{
+	ReleaseBuilder(agent);
+	Builders.Remove(agent);
+}
+
+void UBuilderScheduler::ReleaseBuilder(int agent)
+{
+	int32* assigned = Builders.Find(agent);
+
+	if (!assigned || *assigned == INDEX_NONE)
+		return;
+
+	if (FBuilderJob* job = Jobs.Find(*assigned))
+		job->Builders.Remove(agent);
+
+	*assigned = INDEX_NONE;
+}
+
+int UBuilderScheduler::GetBuilderJob(int agent) const
+{
+	const int32* assigned = Builders.Find(agent);
+	return assigned ? *assigned : -1;
+}
+
+TArray<int> UBuilderScheduler::GetJobBuilders(int job) const
+{
+	const FBuilderJob* found = Jobs.Find(job);
+	return found ? found->Builders : TArray<int>();
+}
+
+void UBuilderScheduler::Tick(float dt)
+{
+	TimeSinceSchedule += dt;
+
+	if (TimeSinceSchedule < ScheduleInterval)
+		return;
+
+	TimeSinceSchedule = 0.0f;
+	Schedule();
+}
+
+void UBuilderScheduler::Schedule()
+{
+	if (!Graph || !Agents)
+		return;
+
+	const int32 batchSize = FMath::Max(1, MaxBatchSize);
+
+	// Idle builders that are on the graph, promoted ones are being controlled directly
+	TArray<int32> idle, idleNodes;
+
+	for (auto& builder : Builders)
+	{
+		if (builder.Value != INDEX_NONE || idle.Num() >= batchSize)
+			continue;
+
+		int32 node = Agents->GetAgentNode(builder.Key);
+
+		if (node >= 0 && Agents->GetAgentState(builder.Key) != EAgentState::Promoted)
+		{
+			idle.Add(builder.Key);
+			idleNodes.Add(node);
+		}
+	}
+
+	auto snapshot = Graph->GetSnapshot();
+
+	if (!snapshot.IsValid())
+		return;
+
+	// One slot per missing builder, oldest jobs first
+	TArray<int32> jobIds, slots;
+	Jobs.GetKeys(jobIds);
+	jobIds.Sort();
+
+	TArray<int32> openJobs, jobNodes;
+	Stats.OpenJobs = 0;
+
+	for (int32 id : jobIds)
+	{
+		FBuilderJob& job = Jobs[id];
+		int32 missing = job.Required - job.Builders.Num();
+
+		if (missing <= 0)
+			continue;
+
+		++Stats.OpenJobs;
+
+		if (slots.Num() >= batchSize)
+			continue;
+
+		// Builders walk to a passable node next to a covered site, the site node itself can't be entered
+		int32 node = ResolveSiteNode(*snapshot, job.Node);
+
+		if (node == INDEX_NONE)
+		{
+			if (!job.WarnedUnreachable)
+				UE_LOG(LogTemp, Warning, TEXT("Job %d at node %d has no passable node nearby, it can't be staffed"), id, job.Node);
+
+			job.WarnedUnreachable = true;
+			continue;
+		}
+
+		job.WarnedUnreachable = false;
+
+		for (int32 i = 0; i < missing && slots.Num() < batchSize; ++i)
+			slots.Add(openJobs.Num());
+
+		openJobs.Add(id);
+		jobNodes.Add(node);
+	}
+
+	Stats.IdleBuilders = idle.Num();
+
+	if (idle.Num() == 0 || slots.Num() == 0)
+		return;
+
+	double start = FPlatformTime::Seconds();
+
+	// Dijkstra from each site covers every builder at once, slots of one job share it
+	TArray<double> jobCosts;
+	jobCosts.SetNumUninitialized(openJobs.Num() * idle.Num());
+
+	ParallelFor(openJobs.Num(), [&](int32 j)
+	{
+		TArray<int32> goals, distance, next;
+		goals.Add(jobNodes[j]);
+
+		// Stops at the farthest idle builder instead of covering the whole planet
+		snapshot->ComputeDistanceField(goals, distance, next, &idleNodes);
+
+		for (int32 b = 0; b < idle.Num(); ++b)
+		{
+			int32 d = distance.IsValidIndex(idleNodes[b]) ? distance[idleNodes[b]] : MAX_int32;
+			jobCosts[j * idle.Num() + b] = d == MAX_int32 ? UnreachableCost : (double)d;
+		}
+	});
+
+	// The solver wants no more rows than columns
+	const bool slotRows = slots.Num() <= idle.Num();
+	const int32 rows = slotRows ? slots.Num() : idle.Num();
+	const int32 cols = slotRows ? idle.Num() : slots.Num();
+
+	TArray<double> cost;
+	cost.SetNumUninitialized(rows * cols);
+
+	for (int32 s = 0; s < slots.Num(); ++s)
+	{
+		for (int32 b = 0; b < idle.Num(); ++b)
+		{
+			double c = jobCosts[slots[s] * idle.Num() + b];
+
+			if (slotRows)
+				cost[s * cols + b] = c;
+			else
+				cost[b * cols + s] = c;
+		}
+	}
+
+	TArray<int32> rowToCol;
+	SolveAssignment(cost, rows, cols, rowToCol);
+
+	double now = FPlatformTime::Seconds();
+	double solveTime = (now - start) * 1000.0;
+	double travel = 0.0;
+
+	for (int32 r = 0; r < rows; ++r)
+	{
+		int32 c = rowToCol[r];
+
+		if (c == INDEX_NONE || cost[r * cols + c] >= UnreachableCost)
+			continue;
+
+		int32 s = slotRows ? r : c;
+		int32 b = slotRows ? c : r;
+
+		int32 jobId = openJobs[slots[s]];
+		int32 agent = idle[b];
+		FBuilderJob& job = Jobs[jobId];
+
+		if (!Agents->MoveAgent(agent, jobNodes[slots[s]], PathPriority))
+			continue;
+
+		job.Builders.Add(agent);
+		Builders[agent] = jobId;
+
+		travel += cost[r * cols + c];
+		LatencyTotal += now - job.PostTime;
+		++Stats.Assigned;
+
+		OnBuilderAssigned.Broadcast(agent, jobId);
+	}
+
+	++NumSolves;
+	SolveTimeTotal += solveTime;
+
+	Stats.LastSolveTime = (float)solveTime;
+	Stats.AverageSolveTime = (float)(SolveTimeTotal / NumSolves);
+	Stats.AverageAssignmentLatency = Stats.Assigned > 0 ? (float)(LatencyTotal / Stats.Assigned) : 0.0f;
+	Stats.LastTravelCost = (float)travel;
+	Stats.TotalTravelCost += (float)travel;
+}
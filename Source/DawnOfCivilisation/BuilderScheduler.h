@@ -0,0 +1,157 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/NoExportTypes.h"
+#include "Tickable.h"
+#include "BuilderScheduler.generated.h"
+
+class UNodeGraph;
+class AAgentSimulation;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnBuilderAssigned, int, Builder, int, Job);
+
+USTRUCT(BlueprintType)
+struct FBuilderSchedulerStats
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	int OpenJobs;
+
+	UPROPERTY(BlueprintReadOnly)
+	int IdleBuilders;
+
+	UPROPERTY(BlueprintReadOnly)
+	int Assigned;
+
+	/* Time spent building the cost matrix and solving it, in milliseconds */
+	UPROPERTY(BlueprintReadOnly)
+	float LastSolveTime;
+
+	UPROPERTY(BlueprintReadOnly)
+	float AverageSolveTime;
+
+	/* Job posted to builder assigned, in seconds */
+	UPROPERTY(BlueprintReadOnly)
+	float AverageAssignmentLatency;
+
+	/* Sum of graph path costs from each builder to its job */
+	UPROPERTY(BlueprintReadOnly)
+	float LastTravelCost;
+
+	UPROPERTY(BlueprintReadOnly)
+	float TotalTravelCost;
+
+	FBuilderSchedulerStats() : OpenJobs(0), IdleBuilders(0), Assigned(0), LastSolveTime(0.0f), AverageSolveTime(0.0f),
+		AverageAssignmentLatency(0.0f), LastTravelCost(0.0f), TotalTravelCost(0.0f) {}
+};
+
+struct FBuilderJob
+{
+	int32 Node;
+	int32 Required;
+	TArray<int32> Builders;
+	double PostTime;
+
+	/* Set once the site has been reported as unreachable, so the warning isn't repeated every pass */
+	bool WarnedUnreachable;
+};
+
+/**
+ * Collects open construction jobs and idle builders, and every interval
+ * assigns them all at once so the total travel cost is minimal. Costs come
+ * from one distance field per job on the node graph snapshot, winners are
+ * sent off through the agent simulation's path requests.
+ */
+UCLASS(BlueprintType)
+class DAWNOFCIVILISATION_API UBuilderScheduler : public UObject, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+	public:
+		UBuilderScheduler();
+
+		void Tick(float dt) override;
+		bool IsTickable() const override { return Graph != NULL && Agents != NULL; }
+		TStatId GetStatId() const override { RETURN_QUICK_DECLARE_CYCLE_STAT(UBuilderScheduler, STATGROUP_Tickables); }
+
+		/* Builders are agent ids in the simulation */
+		UFUNCTION(BlueprintCallable)
+		void Initialise(UNodeGraph* graph, AAgentSimulation* agents);
+
+		/* A site at node needing this many builders, returns the job id */
+		UFUNCTION(BlueprintCallable)
+		int AddJob(int node, int buildersRequired);
+
+		/* Same as AddJob with the count from the building's IBuilding::GetNumBuildersRequired */
+		UFUNCTION(BlueprintCallable)
+		int AddBuildingJob(AActor* building, int node);
+
+		/* Finishes or cancels a job, its builders go back to idle */
+		UFUNCTION(BlueprintCallable)
+		bool RemoveJob(int job);
+
+		UFUNCTION(BlueprintCallable)
+		void AddBuilder(int agent);
+
+		UFUNCTION(BlueprintCallable)
+		void RemoveBuilder(int agent);
+
+		/* Takes the builder off its job, it is considered again on the next scheduling pass */
+		UFUNCTION(BlueprintCallable)
+		void ReleaseBuilder(int agent);
+
+		/* Job the builder is assigned to, -1 if idle */
+		UFUNCTION(BlueprintCallable)
+		int GetBuilderJob(int agent) const;
+
+		UFUNCTION(BlueprintCallable)
+		TArray<int> GetJobBuilders(int job) const;
+
+		/* Runs a scheduling pass now instead of waiting for the interval */
+		UFUNCTION(BlueprintCallable)
+		void Schedule();
+
+		UFUNCTION(BlueprintCallable)
+		FBuilderSchedulerStats GetStats() const { return Stats; }
+
+		UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float ScheduleInterval;
+
+		/* Most builders and job slots considered per pass, the solve is cubic in this */
+		UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		int MaxBatchSize;
+
+		UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		int PathPriority;
+
+		UPROPERTY(BlueprintAssignable)
+		FOnBuilderAssigned OnBuilderAssigned;
+
+	private:
+		/* A builder whose path failed goes back to idle, one removed from the simulation is dropped */
+		UFUNCTION()
+		void OnAgentPathFailed(int agent);
+
+		UFUNCTION()
+		void OnAgentRemoved(int agent);
+
+		UPROPERTY()
+		UNodeGraph* Graph;
+
+		UPROPERTY()
+		AAgentSimulation* Agents;
+
+		TMap<int32, FBuilderJob> Jobs;
+		int32 NextJobId;
+
+		/* Agent id -> job id, INDEX_NONE while idle */
+		TMap<int32, int32> Builders;
+
+		float TimeSinceSchedule;
+		int32 NumSolves;
+		double SolveTimeTotal;
+		double LatencyTotal;
+
+		FBuilderSchedulerStats Stats;
+};
@@ -7,21 +7,28 @@
 #include "Building.generated.h"
 
 // This class does not need to be modified.
-UINTERFACE(MinimalAPI)
+UINTERFACE(MinimalAPI, Blueprintable)
 class UBuilding : public UInterface
 {
 	GENERATED_BODY()
 };
 
 /**
- * 
+ * Implemented by the building blueprints as well as native classes, so callers
+ * check Implements<UBuilding>() and go through the Execute_ wrappers; a Cast
+ * to IBuilding is always null for a blueprint implementation.
  */
 class DAWNOFCIVILISATION_API IBuilding //: public AActor
 {
 	GENERATED_BODY()
 
 	public:
-		virtual FName GetBuildingName() = 0;
-		virtual float GetBuildTime() = 0;
-		virtual int   GetNumBuildersRequired() = 0;
+		UFUNCTION(BlueprintCallable, BlueprintNativeEvent)
+		FName GetBuildingName();
+
+		UFUNCTION(BlueprintCallable, BlueprintNativeEvent)
+		float GetBuildTime();
+
+		UFUNCTION(BlueprintCallable, BlueprintNativeEvent)
+		int GetNumBuildersRequired();
 };
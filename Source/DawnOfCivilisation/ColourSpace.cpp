@@ -3,6 +3,69 @@
 
 #include "ColourSpace.h"
 
+/* Four colours split into one register per channel */
+struct FColourLanes
+{
+	VectorRegister X, Y, Z;
+
+	void Load(const FVector* colours)
+	{
+		float x[4], y[4], z[4];
+
+		for (int32 i = 0; i < 4; ++i)
+			x[i] = colours[i].X, y[i] = colours[i].Y, z[i] = colours[i].Z;
+
+		X = VectorLoad(x);
+		Y = VectorLoad(y);
+		Z = VectorLoad(z);
+	}
+
+	void Store(FVector* colours) const
+	{
+		float x[4], y[4], z[4];
+
+		VectorStore(X, x);
+		VectorStore(Y, y);
+		VectorStore(Z, z);
+
+		for (int32 i = 0; i < 4; ++i)
+			colours[i] = FVector(x[i], y[i], z[i]);
+	}
+};
+
+static FORCEINLINE VectorRegister VectorLess(const VectorRegister& a, const VectorRegister& b)
+{
+	return VectorCompareGT(b, a);
+}
+
+static FORCEINLINE VectorRegister VectorDiv(const VectorRegister& a, const VectorRegister& b)
+{
+	return VectorMultiply(a, VectorReciprocalAccurate(b));
+}
+
+/* Lane-wise HueCalculations, later branches are selected first so earlier ones win */
+static FORCEINLINE VectorRegister HueCalculationsVector(const VectorRegister& v1, const VectorRegister& v2, VectorRegister hue)
+{
+	const VectorRegister zero = VectorZero();
+	const VectorRegister one = VectorOne();
+	const VectorRegister six = MakeVectorRegister(6.0f, 6.0f, 6.0f, 6.0f);
+	const VectorRegister twoThirds = MakeVectorRegister(2.0f / 3, 2.0f / 3, 2.0f / 3, 2.0f / 3);
+
+	hue = VectorSelect(VectorLess(hue, zero), VectorAdd(hue, one), hue);
+	hue = VectorSelect(VectorCompareGT(hue, one), VectorSubtract(hue, one), hue);
+
+	VectorRegister delta = VectorSubtract(v2, v1);
+	VectorRegister rising = VectorMultiplyAdd(delta, VectorMultiply(six, hue), v1);
+	VectorRegister falling = VectorMultiplyAdd(delta, VectorMultiply(VectorSubtract(twoThirds, hue), six), v1);
+
+	VectorRegister result = v1;
+	result = VectorSelect(VectorLess(VectorMultiply(hue, MakeVectorRegister(3.0f, 3.0f, 3.0f, 3.0f)), MakeVectorRegister(2.0f, 2.0f, 2.0f, 2.0f)), falling, result);
+	result = VectorSelect(VectorLess(VectorMultiply(hue, MakeVectorRegister(2.0f, 2.0f, 2.0f, 2.0f)), one), v2, result);
+	result = VectorSelect(VectorLess(VectorMultiply(hue, six), one), rising, result);
+
+	return result;
+}
+
 FVector UColourSpace::RGBToHSL(FVector rgb)
 {
 	float H = 0.0f, S = 0.0f, L = 0.0f;
@@ -86,4 +149,102 @@ float UColourSpace::HueCalculations(float v1, float v2, float hue) {
 
 
 	return v1;
-}
\ No newline at end of file
+}
+
+void UColourSpace::RGBToHSLBatch(const TArray<FVector>& rgb, TArray<FVector>& hsl)
+{
+	hsl.SetNumUninitialized(rgb.Num());
+	RGBToHSLBatch(rgb.GetData(), hsl.GetData(), rgb.Num());
+}
+
+void UColourSpace::HSLToRGBBatch(const TArray<FVector>& hsl, TArray<FVector>& rgb)
+{
+	rgb.SetNumUninitialized(hsl.Num());
+	HSLToRGBBatch(hsl.GetData(), rgb.GetData(), hsl.Num());
+}
+
+void UColourSpace::RGBToHSLBatch(const FVector* rgb, FVector* hsl, int32 num)
+{
+	const VectorRegister zero = VectorZero();
+	const VectorRegister two = MakeVectorRegister(2.0f, 2.0f, 2.0f, 2.0f);
+	const VectorRegister fifty = MakeVectorRegister(50.0f, 50.0f, 50.0f, 50.0f);
+	const VectorRegister sixty = MakeVectorRegister(60.0f, 60.0f, 60.0f, 60.0f);
+	const VectorRegister hundred = MakeVectorRegister(100.0f, 100.0f, 100.0f, 100.0f);
+	const VectorRegister offsetG = MakeVectorRegister(120.0f, 120.0f, 120.0f, 120.0f);
+	const VectorRegister offsetB = MakeVectorRegister(240.0f, 240.0f, 240.0f, 240.0f);
+	const VectorRegister fullTurn = MakeVectorRegister(360.0f, 360.0f, 360.0f, 360.0f);
+
+	int32 i = 0;
+
+	for (; i + 4 <= num; i += 4)
+	{
+		FColourLanes c;
+		c.Load(rgb + i);
+
+		VectorRegister min = VectorMin(VectorMin(c.X, c.Y), c.Z);
+		VectorRegister max = VectorMax(VectorMax(c.X, c.Y), c.Z);
+		VectorRegister range = VectorSubtract(max, min);
+		VectorRegister sum = VectorAdd(max, min);
+
+		VectorRegister L = VectorMultiply(fifty, sum);
+		VectorRegister S = VectorDiv(VectorMultiply(hundred, range), VectorSelect(VectorLess(L, fifty), sum, VectorSubtract(two, sum)));
+
+		// Grey lanes divide by zero here and are replaced below
+		VectorRegister H = zero;
+		H = VectorSelect(VectorCompareEQ(max, c.X), VectorDiv(VectorMultiply(sixty, VectorSubtract(c.Y, c.Z)), range), H);
+		H = VectorSelect(VectorCompareEQ(max, c.Y), VectorAdd(VectorDiv(VectorMultiply(sixty, VectorSubtract(c.Z, c.X)), range), offsetG), H);
+		H = VectorSelect(VectorCompareEQ(max, c.Z), VectorAdd(VectorDiv(VectorMultiply(sixty, VectorSubtract(c.X, c.Y)), range), offsetB), H);
+		H = VectorSelect(VectorLess(H, zero), VectorAdd(H, fullTurn), H);
+
+		VectorRegister grey = VectorCompareEQ(min, max);
+
+		FColourLanes out;
+		out.X = VectorSelect(grey, zero, H);
+		out.Y = VectorSelect(grey, zero, S);
+		out.Z = L;
+		out.Store(hsl + i);
+	}
+
+	for (; i < num; ++i)
+		hsl[i] = RGBToHSL(rgb[i]);
+}
+
+void UColourSpace::HSLToRGBBatch(const FVector* hsl, FVector* rgb, int32 num)
+{
+	const VectorRegister zero = VectorZero();
+	const VectorRegister one = VectorOne();
+	const VectorRegister half = MakeVectorRegister(0.5f, 0.5f, 0.5f, 0.5f);
+	const VectorRegister third = MakeVectorRegister(1.0f / 3, 1.0f / 3, 1.0f / 3, 1.0f / 3);
+	const VectorRegister hundred = MakeVectorRegister(100.0f, 100.0f, 100.0f, 100.0f);
+	const VectorRegister invHundred = MakeVectorRegister(1.0f / 100, 1.0f / 100, 1.0f / 100, 1.0f / 100);
+	const VectorRegister invFullTurn = MakeVectorRegister(1.0f / 360, 1.0f / 360, 1.0f / 360, 1.0f / 360);
+	const VectorRegister byteMax = MakeVectorRegister(255.0f, 255.0f, 255.0f, 255.0f);
+
+	int32 i = 0;
+
+	for (; i + 4 <= num; i += 4)
+	{
+		FColourLanes c;
+		c.Load(hsl + i);
+
+		VectorRegister L = VectorMultiply(VectorMin(VectorMax(c.Z, zero), hundred), invHundred);
+		VectorRegister S = VectorMultiply(c.Y, invHundred);
+		VectorRegister hue = VectorMultiply(c.X, invFullTurn);
+
+		VectorRegister v2 = VectorSelect(VectorLess(L, half), VectorMultiply(L, VectorAdd(one, S)), VectorSubtract(VectorAdd(L, S), VectorMultiply(L, S)));
+		VectorRegister v1 = VectorSubtract(VectorAdd(L, L), v2);
+
+		// Matches the scalar version, which returns greys on a 0-255 scale
+		VectorRegister grey = VectorCompareEQ(S, zero);
+		VectorRegister greyValue = VectorMultiply(L, byteMax);
+
+		FColourLanes out;
+		out.X = VectorSelect(grey, greyValue, HueCalculationsVector(v1, v2, VectorAdd(hue, third)));
+		out.Y = VectorSelect(grey, greyValue, HueCalculationsVector(v1, v2, hue));
+		out.Z = VectorSelect(grey, greyValue, HueCalculationsVector(v1, v2, VectorSubtract(hue, third)));
+		out.Store(rgb + i);
+	}
+
+	for (; i < num; ++i)
+		rgb[i] = HSLToRGB(hsl[i]);
+}
@@ -18,6 +18,17 @@ class DAWNOFCIVILISATION_API UColourSpace : public UBlueprintFunctionLibrary
 		static FVector RGBToHSL(FVector rgb);
 		static FVector HSLToRGB(FVector hsl);
 
+		/* Same results as the scalar versions, four colours at a time */
+		UFUNCTION(BlueprintCallable)
+		static void RGBToHSLBatch(const TArray<FVector>& rgb, TArray<FVector>& hsl);
+
+		UFUNCTION(BlueprintCallable)
+		static void HSLToRGBBatch(const TArray<FVector>& hsl, TArray<FVector>& rgb);
+
+		/* in and out may be the same buffer */
+		static void RGBToHSLBatch(const FVector* rgb, FVector* hsl, int32 num);
+		static void HSLToRGBBatch(const FVector* hsl, FVector* rgb, int32 num);
+
 private:
 		static float HueCalculations(float v1, float v2, float hue);
 };
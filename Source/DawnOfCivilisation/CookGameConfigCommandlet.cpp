@@ -0,0 +1,15 @@
+#include "CookGameConfigCommandlet.h"
+#include "GameConfig.h"
+
+int32 UCookGameConfigCommandlet::Main(const FString& Params)
+{
+	FString error;
+
+	if (!FGameConfig::CookBinary(error))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not cook game config: %s"), *error);
+		return 1;
+	}
+
+	return 0;
+}
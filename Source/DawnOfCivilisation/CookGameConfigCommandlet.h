@@ -0,0 +1,19 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "CookGameConfigCommandlet.generated.h"
+
+/**
+ * Converts Config/GameConfig.json to the binary form cooked builds load. Cooks
+ * already do this when they start, this is for refreshing the binary by hand:
+ * UE4Editor-Cmd <project> -run=CookGameConfig
+ */
+UCLASS()
+class DAWNOFCIVILISATION_API UCookGameConfigCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+	public:
+		int32 Main(const FString& Params) override;
+};
@@ -12,6 +12,10 @@ public class DawnOfCivilisation : ModuleRules
 
 		PrivateDependencyModuleNames.AddRange(new string[] {  });
 
+		// Config hot reload watches GameConfig.json in editor builds
+		if (Target.bBuildEditor)
+			PrivateDependencyModuleNames.Add("DirectoryWatcher");
+
 		// Uncomment if you are using Slate UI
 		// PrivateDependencyModuleNames.AddRange(new string[] { "Slate", "SlateCore" });
 		
@@ -1,6 +1,38 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "DawnOfCivilisation.h"
+#include "GameConfig.h"
 #include "Modules/ModuleManager.h"
+#include "GameDelegates.h"
 
-IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, DawnOfCivilisation, "DawnOfCivilisation" );
+class FDawnOfCivilisationModule : public FDefaultGameModuleImpl
+{
+	public:
+		void StartupModule() override
+		{
+#if WITH_EDITOR
+			// Runs at the start of both the cook commandlet and cooks launched from the editor
+			FGameDelegates::Get().GetCookModificationDelegate().BindStatic(&FDawnOfCivilisationModule::OnCookStarted);
+#endif
+		}
+
+		void ShutdownModule() override
+		{
+#if WITH_EDITOR
+			FGameDelegates::Get().GetCookModificationDelegate().Unbind();
+#endif
+		}
+
+#if WITH_EDITOR
+	private:
+		static void OnCookStarted(TArray<FString>& extraPackages)
+		{
+			FString error;
+
+			if (!FGameConfig::CookBinary(error))
+				UE_LOG(LogTemp, Error, TEXT("Could not cook game config: %s"), *error);
+		}
+#endif
+};
+
+IMPLEMENT_PRIMARY_GAME_MODULE( FDawnOfCivilisationModule, DawnOfCivilisation, "DawnOfCivilisation" );
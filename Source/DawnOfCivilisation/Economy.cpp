@@ -0,0 +1,286 @@
+#include "Economy.h"
+#include "Async/ParallelFor.h"
+
+static_assert((int32)EResourceType::Silicon < MaxResourceTypes, "MaxResourceTypes is too small for EResourceType");
+
+/* Records per ParallelFor task, small batches aren't worth the dispatch */
+static const int32 EconomyChunkSize = 1024;
+
+int32 FEconomyRecords::Add(int32 id, EResourceType resource, float rate, float capacity, float energyDraw)
+{
+	Ids.Add(id);
+	Resource.Add((uint8)resource);
+	Rate.Add(rate);
+	Buffer.Add(0.0f);
+	Capacity.Add(capacity);
+	EnergyDraw.Add(energyDraw);
+	return Active.Add(true);
+}
+
+void FEconomyRecords::RemoveAtSwap(int32 index)
+{
+	Ids.RemoveAtSwap(index, 1, false);
+	Resource.RemoveAtSwap(index, 1, false);
+	Rate.RemoveAtSwap(index, 1, false);
+	Buffer.RemoveAtSwap(index, 1, false);
+	Capacity.RemoveAtSwap(index, 1, false);
+	EnergyDraw.RemoveAtSwap(index, 1, false);
+	Active.RemoveAtSwap(index, 1, false);
+}
+
+UEconomy::UEconomy()
+	: FixedStep(0.1f),
+	  MaxStepsPerFrame(10),
+	  NextHandle(1),
+	  Accumulator(0.0f),
+	  EnergyDraw(0.0f)
+{
+	FMemory::Memzero(Amounts);
+	FMemory::Memzero(Unlocked);
+}
+
+void UEconomy::Advance(float dt)
+{
+	Accumulator += dt;
+
+	int32 steps = 0;
+
+	while (Accumulator >= FixedStep && steps < MaxStepsPerFrame)
+	{
+		Step(FixedStep);
+		Accumulator -= FixedStep;
+		++steps;
+	}
+
+	if (steps == MaxStepsPerFrame)
+		Accumulator = FMath::Min(Accumulator, FixedStep);
+}
+
+void UEconomy::Step(float dt)
+{
+	StepProducers(dt);
+	StepConsumers(dt);
+}
+
+void UEconomy::StepProducers(float dt)
+{
+	const int32 numChunks = FMath::DivideAndRoundUp(Producers.Num(), EconomyChunkSize);
+
+	struct FChunkResult
+	{
+		int32 Produced[MaxResourceTypes];
+		float Energy;
+	};
+
+	TArray<FChunkResult> results;
+	results.SetNumZeroed(numChunks);
+
+	ParallelFor(numChunks, [&](int32 chunk)
+	{
+		FChunkResult& result = results[chunk];
+		const int32 end = FMath::Min((chunk + 1) * EconomyChunkSize, Producers.Num());
+
+		for (int32 i = chunk * EconomyChunkSize; i < end; ++i)
+		{
+			if (!Producers.Active[i])
+				continue;
+
+			float buffer = Producers.Buffer[i] + Producers.Rate[i] * dt;
+			int32 whole = FMath::FloorToInt(buffer);
+
+			Producers.Buffer[i] = buffer - whole;
+			result.Produced[Producers.Resource[i]] += whole;
+			result.Energy += Producers.EnergyDraw[i];
+		}
+	}, numChunks <= 1);
+
+	float energy = 0.0f;
+
+	for (const FChunkResult& result : results)
+	{
+		for (int32 r = 0; r < MaxResourceTypes; ++r)
+			Amounts[r] += result.Produced[r];
+
+		energy += result.Energy;
+	}
+
+	EnergyDraw = energy;
+}
+
+void UEconomy::StepConsumers(float dt)
+{
+	const int32 numChunks = FMath::DivideAndRoundUp(Consumers.Num(), EconomyChunkSize);
+
+	struct FChunkResult
+	{
+		int32 Demand[MaxResourceTypes];
+		float Energy;
+	};
+
+	TArray<FChunkResult> results;
+	results.SetNumZeroed(numChunks);
+
+	// Demand accumulates in Buffer up to Capacity, whole units are what gets requested
+	ParallelFor(numChunks, [&](int32 chunk)
+	{
+		FChunkResult& result = results[chunk];
+		const int32 end = FMath::Min((chunk + 1) * EconomyChunkSize, Consumers.Num());
+
+		for (int32 i = chunk * EconomyChunkSize; i < end; ++i)
+		{
+			if (!Consumers.Active[i])
+				continue;
+
+			Consumers.Buffer[i] = FMath::Min(Consumers.Buffer[i] + Consumers.Rate[i] * dt, Consumers.Capacity[i]);
+			result.Demand[Consumers.Resource[i]] += FMath::FloorToInt(Consumers.Buffer[i]);
+			result.Energy += Consumers.EnergyDraw[i];
+		}
+	}, numChunks <= 1);
+
+	int32 demand[MaxResourceTypes] = { 0 };
+
+	for (const FChunkResult& result : results)
+	{
+		for (int32 r = 0; r < MaxResourceTypes; ++r)
+			demand[r] += result.Demand[r];
+
+		EnergyDraw += result.Energy;
+	}
+
+	bool shortage[MaxResourceTypes];
+
+	for (int32 r = 0; r < MaxResourceTypes; ++r)
+	{
+		shortage[r] = demand[r] > Amounts[r];
+
+		if (!shortage[r])
+			Amounts[r] -= demand[r];
+	}
+
+	// Resources with enough stock: every consumer of them is served at once
+	ParallelFor(numChunks, [&](int32 chunk)
+	{
+		const int32 end = FMath::Min((chunk + 1) * EconomyChunkSize, Consumers.Num());
+
+		for (int32 i = chunk * EconomyChunkSize; i < end; ++i)
+		{
+			if (!Consumers.Active[i] || shortage[Consumers.Resource[i]])
+				continue;
+
+			Consumers.Buffer[i] -= FMath::FloorToInt(Consumers.Buffer[i]);
+			Supplied[i] = true;
+		}
+	}, numChunks <= 1);
+
+	// Short resources go to the oldest consumers first, a serial pass but only over the short types
+	bool anyShortage = false;
+
+	for (bool s : shortage)
+		anyShortage |= s;
+
+	if (!anyShortage)
+		return;
+
+	for (int32 i = 0; i < Consumers.Num(); ++i)
+	{
+		const uint8 r = Consumers.Resource[i];
+
+		if (!Consumers.Active[i] || !shortage[r])
+			continue;
+
+		int32 want = FMath::FloorToInt(Consumers.Buffer[i]);
+		Supplied[i] = want <= Amounts[r];
+
+		if (Supplied[i])
+		{
+			Amounts[r] -= want;
+			Consumers.Buffer[i] -= want;
+		}
+	}
+}
+
+int UEconomy::AddProducer(EResourceType resource, float rate, float energyDraw)
+{
+	int32 handle = NextHandle++;
+	int32 index = Producers.Add(handle, resource, FMath::Max(rate, 0.0f), MAX_flt, energyDraw);
+
+	Handles.Add(handle, { false, index });
+	return handle;
+}
+
+int UEconomy::AddConsumer(EResourceType resource, float rate, float energyDraw)
+{
+	int32 handle = NextHandle++;
+
+	// At most one step's worth plus a unit can be owed, so a stalled consumer doesn't build up debt
+	float capacity = FMath::Max(rate, 0.0f) * FixedStep + 1.0f;
+	int32 index = Consumers.Add(handle, resource, FMath::Max(rate, 0.0f), capacity, energyDraw);
+
+	Supplied.Add(true);
+	Handles.Add(handle, { true, index });
+	return handle;
+}
+
+bool UEconomy::RemoveBuilding(int handle)
+{
+	FEconomyHandle ref;
+
+	if (!Handles.RemoveAndCopyValue(handle, ref))
+		return false;
+
+	FEconomyRecords& records = ref.Consumer ? Consumers : Producers;
+
+	records.RemoveAtSwap(ref.Index);
+
+	if (ref.Consumer)
+		Supplied.RemoveAtSwap(ref.Index, 1, false);
+
+	if (ref.Index < records.Num())
+		Handles[records.Ids[ref.Index]].Index = ref.Index;
+
+	// Advance isn't called without buildings, so the last step's draw would otherwise stick
+	if (Handles.Num() == 0)
+		EnergyDraw = 0.0f;
+
+	return true;
+}
+
+void UEconomy::RemoveAllBuildings()
+{
+	Producers = FEconomyRecords();
+	Consumers = FEconomyRecords();
+	Supplied.Reset();
+	Handles.Reset();
+
+	Accumulator = 0.0f;
+	EnergyDraw = 0.0f;
+}
+
+bool UEconomy::SetBuildingActive(int handle, bool active)
+{
+	const FEconomyHandle* ref = Handles.Find(handle);
+
+	if (!ref)
+		return false;
+
+	(ref->Consumer ? Consumers : Producers).Active[ref->Index] = active;
+	return true;
+}
+
+bool UEconomy::IsBuildingSupplied(int handle) const
+{
+	const FEconomyHandle* ref = Handles.Find(handle);
+	return ref && (!ref->Consumer || Supplied[ref->Index]);
+}
+
+void UEconomy::AddAmounts(const TMap<EResourceType, int>& amounts)
+{
+	for (auto& amount : amounts)
+		Amounts[(int32)amount.Key] += amount.Value;
+}
+
+void UEconomy::SubtractAmounts(const TMap<EResourceType, int>& amounts)
+{
+	for (auto& amount : amounts)
+		Amounts[(int32)amount.Key] -= amount.Value;
+}
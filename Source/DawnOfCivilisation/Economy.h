@@ -0,0 +1,124 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/NoExportTypes.h"
+#include "GameManager.h"
+#include "Economy.generated.h"
+
+/**
+ * Producer or consumer buildings stored as parallel arrays so a step walks
+ * each field contiguously. Rates are units per second, Buffer holds the
+ * fractional units not yet moved to (or taken from) the stockpile.
+ */
+struct FEconomyRecords
+{
+	TArray<int32> Ids;
+	TArray<uint8> Resource;
+	TArray<float> Rate;
+	TArray<float> Buffer;
+	TArray<float> Capacity;
+	TArray<float> EnergyDraw;
+	TArray<bool> Active;
+
+	int32 Num() const { return Ids.Num(); }
+
+	int32 Add(int32 id, EResourceType resource, float rate, float capacity, float energyDraw);
+	void RemoveAtSwap(int32 index);
+};
+
+struct FEconomyHandle
+{
+	bool Consumer;
+	int32 Index;
+};
+
+/**
+ * Resource stockpile plus every building that produces or consumes from it,
+ * advanced in fixed steps from UGameManager::Tick rather than per building.
+ */
+UCLASS(BlueprintType)
+class DAWNOFCIVILISATION_API UEconomy : public UObject
+{
+	GENERATED_BODY()
+
+	public:
+		UEconomy();
+
+		/* Seconds of simulation per step */
+		UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float FixedStep;
+
+		/* Steps dropped after a long frame instead of spiralling */
+		UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		int MaxStepsPerFrame;
+
+		void Advance(float dt);
+
+		UFUNCTION(BlueprintCallable)
+		int AddProducer(EResourceType resource, float rate, float energyDraw = 0.0f);
+
+		/* Takes rate units per second from the stockpile, stalls while it can't */
+		UFUNCTION(BlueprintCallable)
+		int AddConsumer(EResourceType resource, float rate, float energyDraw = 0.0f);
+
+		UFUNCTION(BlueprintCallable)
+		bool RemoveBuilding(int handle);
+
+		/* Drops every producer and consumer, handles given out before stay invalid */
+		void RemoveAllBuildings();
+
+		UFUNCTION(BlueprintCallable)
+		bool SetBuildingActive(int handle, bool active);
+
+		/* False while a consumer is waiting on resources */
+		UFUNCTION(BlueprintCallable)
+		bool IsBuildingSupplied(int handle) const;
+
+		UFUNCTION(BlueprintCallable)
+		int GetAmount(EResourceType resource) const { return Amounts[(int32)resource]; }
+
+		UFUNCTION(BlueprintCallable)
+		void AddAmount(EResourceType resource, int amount) { Amounts[(int32)resource] += amount; }
+
+		void AddAmounts(const TMap<EResourceType, int>& amounts);
+		void SubtractAmounts(const TMap<EResourceType, int>& amounts);
+
+		UFUNCTION(BlueprintCallable)
+		bool IsUnlocked(EResourceType resource) const { return Unlocked[(int32)resource]; }
+
+		UFUNCTION(BlueprintCallable)
+		void Unlock(EResourceType resource) { Unlocked[(int32)resource] = true; }
+
+		/* Unlock can't be taken back in play, this is for restoring a save */
+		void SetUnlocked(EResourceType resource, bool unlocked) { Unlocked[(int32)resource] = unlocked; }
+
+		/* Watts drawn by every active building */
+		UFUNCTION(BlueprintCallable)
+		float GetEnergyDraw() const { return EnergyDraw; }
+
+		UFUNCTION(BlueprintCallable)
+		int GetNumBuildings() const { return Handles.Num(); }
+
+		/* Stockpile indexed by EResourceType, MaxResourceTypes long */
+		const int32* GetAmounts() const { return Amounts; }
+
+	private:
+		void Step(float dt);
+		void StepProducers(float dt);
+		void StepConsumers(float dt);
+
+		int32 Amounts[MaxResourceTypes];
+		bool Unlocked[MaxResourceTypes];
+
+		FEconomyRecords Producers;
+		FEconomyRecords Consumers;
+
+		/* Consumers that got everything they asked for last step */
+		TArray<bool> Supplied;
+
+		TMap<int32, FEconomyHandle> Handles;
+		int32 NextHandle;
+
+		float Accumulator;
+		float EnergyDraw;
+};
@@ -0,0 +1,8 @@
+#include "FlowField.h"
+
+void UFlowField::Build(const FNodeGraphSnapshot& snapshot, const TArray<int32>& goals)
+{
+	Goals = goals;
+	Version = snapshot.Version;
+	snapshot.ComputeDistanceField(Goals, Distance, Next);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/NoExportTypes.h"
+#include "NodeGraphSnapshot.h"
+#include "FlowField.generated.h"
+
+/**
+ * Distance field towards a set of goal nodes, shared by every agent heading
+ * to the same place. Obtained from UNodeGraph::GetFlowField.
+ */
+UCLASS(BlueprintType)
+class DAWNOFCIVILISATION_API UFlowField : public UObject
+{
+	GENERATED_BODY()
+
+	public:
+		UFlowField() : Version(0) {}
+
+		void Build(const FNodeGraphSnapshot& snapshot, const TArray<int32>& goals);
+		bool HasGoals(const TArray<int32>& sortedGoals) const { return Goals == sortedGoals; }
+		uint32 GetVersion() const { return Version; }
+		void SetVersion(uint32 version) { Version = version; }
+
+		UFUNCTION(BlueprintCallable)
+		int GetNextNode(int node) const { return Next.IsValidIndex(node) ? Next[node] : INDEX_NONE; }
+
+		UFUNCTION(BlueprintCallable)
+		int GetDistance(int node) const { return Distance.IsValidIndex(node) ? Distance[node] : MAX_int32; }
+
+		UFUNCTION(BlueprintCallable)
+		bool CanReachGoal(int node) const { return GetDistance(node) != MAX_int32; }
+
+		UFUNCTION(BlueprintCallable)
+		TArray<int> GetGoals() const { return Goals; }
+
+	private:
+		UPROPERTY()
+		TArray<int> Goals;
+
+		TArray<int32> Distance;
+		TArray<int32> Next;
+		uint32 Version;
+};
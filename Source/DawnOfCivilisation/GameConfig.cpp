@@ -0,0 +1,271 @@
+#include "GameConfig.h"
+#include "Json.h"
+#include "Misc/Paths.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Crc.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/PlatformProperties.h"
+
+static const uint32 GameConfigMagic = 0x47434647; // 'GCFG'
+static const uint32 GameConfigVersion = 2;
+
+FArchive& operator<<(FArchive& ar, FBuildingConfig& b)
+{
+	ar << b.Name << b.Unlocked << b.NumBuilders << b.HP;
+
+	for (int32& amount : b.Resources)
+		ar << amount;
+
+	return ar;
+}
+
+FArchive& operator<<(FArchive& ar, FMilestoneConfig& m)
+{
+	return ar << m.Name << m.Type << m.Data << m.EnergyRequired;
+}
+
+FArchive& operator<<(FArchive& ar, FPrefixConfig& p)
+{
+	return ar << p.Power << p.Short << p.Long;
+}
+
+TSharedRef<const FGameConfig, ESPMode::ThreadSafe>& FGameConfig::GetCurrent()
+{
+	static TSharedRef<const FGameConfig, ESPMode::ThreadSafe> config = MakeShareable(Load());
+	return config;
+}
+
+const FGameConfig& FGameConfig::Get()
+{
+	return *GetCurrent();
+}
+
+TSharedRef<const FGameConfig, ESPMode::ThreadSafe> FGameConfig::GetShared()
+{
+	return GetCurrent();
+}
+
+void FGameConfig::Replace(TSharedRef<const FGameConfig, ESPMode::ThreadSafe> config)
+{
+	check(IsInGameThread());
+	GetCurrent() = config;
+}
+
+FString FGameConfig::GetJsonPath()
+{
+	return FPaths::ProjectConfigDir() / TEXT("GameConfig.json");
+}
+
+FString FGameConfig::GetBinaryPath()
+{
+	// Under Content so DirectoriesToAlwaysStageAsUFS can put it in the pak, Config only stages ini files
+	return FPaths::ProjectContentDir() / TEXT("Config/GameConfig.bin");
+}
+
+FGameConfig* FGameConfig::Load()
+{
+	double begin = FPlatformTime::Seconds();
+
+	FGameConfig* config = new FGameConfig();
+	FString source, error;
+
+	// Editor and uncooked builds always read the JSON so edits show up without a cook step
+	if (FPlatformProperties::RequiresCookedData() && config->LoadBinary(GetBinaryPath(), error))
+	{
+		FString json;
+
+		// Only staged builds that ship the JSON too can check this, packaged ones trust the cook
+		if (FFileHelper::LoadFileToString(json, *GetJsonPath()) && FCrc::StrCrc32(*json) != config->SourceHash)
+			error = FString::Printf(TEXT("%s was cooked from a different %s"), *GetBinaryPath(), *FPaths::GetCleanFilename(GetJsonPath()));
+		else
+			source = GetBinaryPath();
+	}
+
+	if (source.IsEmpty())
+	{
+		if (!error.IsEmpty())
+			UE_LOG(LogTemp, Warning, TEXT("Falling back to JSON game config: %s"), *error);
+
+		*config = FGameConfig();
+
+		if (config->LoadJson(GetJsonPath(), error))
+			source = GetJsonPath();
+		else
+		{
+			UE_LOG(LogTemp, Error, TEXT("Could not load game config: %s"), *error);
+			*config = FGameConfig();
+			return config;
+		}
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Loaded game config from %s in %.2fms (%d buildings, %d milestones, %d prefixes)"),
+		*source, (FPlatformTime::Seconds() - begin) * 1000.0, config->Buildings.Num(), config->Milestones.Num(), config->Prefixes.Num());
+
+	return config;
+}
+
+bool FGameConfig::LoadJson(const FString& path, FString& error)
+{
+	FString text;
+
+	if (!FFileHelper::LoadFileToString(text, *path))
+	{
+		error = FString::Printf(TEXT("%s not found"), *path);
+		return false;
+	}
+
+	if (!ParseJson(text, error))
+		return false;
+
+	SourceHash = FCrc::StrCrc32(*text);
+	return true;
+}
+
+bool FGameConfig::ParseJson(const FString& text, FString& error)
+{
+	TSharedPtr<FJsonObject> json;
+	TSharedRef<TJsonReader<TCHAR>> reader = TJsonReaderFactory<TCHAR>::Create(text);
+
+	if (!FJsonSerializer::Deserialize(reader, json) || !json.IsValid())
+	{
+		error = FString::Printf(TEXT("Error parsing JSON: %s"), *reader->GetErrorMessage());
+		return false;
+	}
+
+	static const TCHAR* resourceFields[] = { TEXT("ResWood"), TEXT("ResMetal"), TEXT("ResCoal"), TEXT("ResOil"), TEXT("ResSilicon") };
+
+	const TArray<TSharedPtr<FJsonValue>>* values;
+
+	if (json->TryGetArrayField("Buildings", values))
+	{
+		Buildings.Reserve(values->Num());
+
+		for (auto& value : *values)
+		{
+			auto fields = value->AsObject();
+
+			FBuildingConfig& building = Buildings.AddDefaulted_GetRef();
+			building.Name = fields->GetStringField("Name");
+			building.Unlocked = fields->HasField("Unlocked") ? fields->GetBoolField("Unlocked") : false;
+			building.NumBuilders = fields->GetIntegerField("NumBuilders");
+			building.HP = fields->GetIntegerField("HP");
+
+			for (int32 i = 0; i < ARRAY_COUNT(resourceFields); ++i)
+				building.Resources[i] = fields->HasField(resourceFields[i]) ? fields->GetIntegerField(resourceFields[i]) : 0;
+		}
+	}
+
+	if (json->TryGetArrayField("Milestones", values))
+	{
+		Milestones.Reserve(values->Num());
+
+		for (auto& value : *values)
+		{
+			auto fields = value->AsObject();
+			auto type = fields->GetStringField("Event");
+
+			FMilestoneConfig& milestone = Milestones.AddDefaulted_GetRef();
+
+			if (type == "UnlockBuilding")	milestone.Type = EEvent::UnlockBuilding;
+			if (type == "UnlockTechnology") milestone.Type = EEvent::UnlockTechnology;
+			if (type == "Achievement")		milestone.Type = EEvent::Achievement;
+
+			milestone.Name = fields->GetStringField("Name");
+			milestone.Data = fields->GetStringField("Data");
+			milestone.EnergyRequired = fields->GetIntegerField("EnergyRequired");
+		}
+	}
+
+	if (json->TryGetArrayField("Prefixes", values))
+	{
+		Prefixes.Reserve(values->Num());
+
+		for (auto& value : *values)
+		{
+			auto fields = value->AsObject();
+
+			FPrefixConfig& prefix = Prefixes.AddDefaulted_GetRef();
+			prefix.Power = fields->GetIntegerField("Power");
+			prefix.Short = fields->GetStringField("Short");
+			prefix.Long = fields->HasField("Long") ? fields->GetStringField("Long") : FString();
+		}
+	}
+
+	return true;
+}
+
+void FGameConfig::Serialize(FArchive& ar)
+{
+	ar << Buildings << Milestones << Prefixes;
+}
+
+bool FGameConfig::LoadBinary(const FString& path, FString& error)
+{
+	TArray<uint8> data;
+
+	if (!FFileHelper::LoadFileToArray(data, *path, FILEREAD_Silent))
+	{
+		error = FString::Printf(TEXT("%s not found"), *path);
+		return false;
+	}
+
+	FMemoryReader reader(data);
+	uint32 magic = 0, version = 0;
+
+	reader << magic << version;
+
+	if (magic != GameConfigMagic || version != GameConfigVersion)
+	{
+		error = FString::Printf(TEXT("%s is not a version %u game config"), *path, GameConfigVersion);
+		return false;
+	}
+
+	reader << SourceHash;
+	Serialize(reader);
+
+	if (reader.IsError())
+	{
+		error = FString::Printf(TEXT("%s is truncated"), *path);
+		return false;
+	}
+
+	return true;
+}
+
+bool FGameConfig::SaveBinary(const FString& path)
+{
+	TArray<uint8> data;
+	FMemoryWriter writer(data);
+
+	uint32 magic = GameConfigMagic, version = GameConfigVersion;
+	writer << magic << version << SourceHash;
+
+	Serialize(writer);
+
+	return FFileHelper::SaveArrayToFile(data, *path);
+}
+
+bool FGameConfig::CookBinary(FString& error)
+{
+	FGameConfig config, cooked;
+	FString ignored;
+
+	if (!config.LoadJson(GetJsonPath(), error))
+		return false;
+
+	if (cooked.LoadBinary(GetBinaryPath(), ignored) && cooked.SourceHash == config.SourceHash)
+		return true;
+
+	if (!config.SaveBinary(GetBinaryPath()))
+	{
+		error = FString::Printf(TEXT("Could not write %s"), *GetBinaryPath());
+		return false;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Wrote %s (%d buildings, %d milestones, %d prefixes)"),
+		*GetBinaryPath(), config.Buildings.Num(), config.Milestones.Num(), config.Prefixes.Num());
+
+	return true;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameManager.h"
+
+struct FBuildingConfig
+{
+	FString Name;
+	bool Unlocked;
+	int32 NumBuilders;
+	int32 HP;
+
+	/* Indexed by EResourceType */
+	int32 Resources[5];
+
+	FBuildingConfig() : Unlocked(false), NumBuilders(0), HP(0) { FMemory::Memzero(Resources); }
+
+	bool operator==(const FBuildingConfig& other) const
+	{
+		return Name == other.Name && Unlocked == other.Unlocked && NumBuilders == other.NumBuilders && HP == other.HP &&
+			FMemory::Memcmp(Resources, other.Resources, sizeof(Resources)) == 0;
+	}
+
+	friend FArchive& operator<<(FArchive& ar, FBuildingConfig& b);
+};
+
+struct FMilestoneConfig
+{
+	FString Name;
+	EEvent Type;
+	FString Data;
+	float EnergyRequired;
+
+	FMilestoneConfig() : Type(EEvent::Achievement), EnergyRequired(0.0f) {}
+
+	bool operator==(const FMilestoneConfig& other) const
+	{
+		return Name == other.Name && Type == other.Type && Data == other.Data && EnergyRequired == other.EnergyRequired;
+	}
+
+	friend FArchive& operator<<(FArchive& ar, FMilestoneConfig& m);
+};
+
+struct FPrefixConfig
+{
+	int32 Power;
+	FString Short;
+	FString Long;
+
+	FPrefixConfig() : Power(0) {}
+
+	bool operator==(const FPrefixConfig& other) const
+	{
+		return Power == other.Power && Short == other.Short && Long == other.Long;
+	}
+
+	friend FArchive& operator<<(FArchive& ar, FPrefixConfig& p);
+};
+
+/**
+ * Typed copy of Config/GameConfig.json. Parsed once per process and shared by
+ * every UGameManager, including the CDO. Cooked builds read the binary form
+ * written at the start of every cook (or by the CookGameConfig commandlet),
+ * which is staged from Content/Config, instead of parsing JSON.
+ */
+struct DAWNOFCIVILISATION_API FGameConfig
+{
+	TArray<FBuildingConfig> Buildings;
+	TArray<FMilestoneConfig> Milestones;
+	TArray<FPrefixConfig> Prefixes;
+
+	/* CRC of the JSON text this was parsed from, stored in the binary so a stale one can be told apart */
+	uint32 SourceHash;
+
+	FGameConfig() : SourceHash(0) {}
+
+	static const FGameConfig& Get();
+	static TSharedRef<const FGameConfig, ESPMode::ThreadSafe> GetShared();
+
+	/* Swaps in a reloaded config for everything that calls Get from now on, game thread only */
+	static void Replace(TSharedRef<const FGameConfig, ESPMode::ThreadSafe> config);
+
+	static FString GetJsonPath();
+	static FString GetBinaryPath();
+
+	bool ParseJson(const FString& text, FString& error);
+	bool LoadJson(const FString& path, FString& error);
+	bool LoadBinary(const FString& path, FString& error);
+	bool SaveBinary(const FString& path);
+
+	/* Rewrites the binary from the JSON, skipped when the binary was already cooked from the same text */
+	static bool CookBinary(FString& error);
+
+	void Serialize(FArchive& ar);
+
+	private:
+		static FGameConfig* Load();
+		static TSharedRef<const FGameConfig, ESPMode::ThreadSafe>& GetCurrent();
+};
+
+typedef TSharedRef<const FGameConfig, ESPMode::ThreadSafe> FGameConfigRef;
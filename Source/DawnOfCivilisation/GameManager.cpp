@@ -1,216 +1,884 @@
 #include "GameManager.h"
+#include "GameConfig.h"
+#include "Economy.h"
+#include "PlanetSaveGame.h"
 #include "ConstructorHelpers.h"
 #include "Engine/Texture.h"
-#include "Engine/Blueprint.h"
-#include "FileManager.h"
+#include "Engine/World.h"
+#include "Async/Async.h"
+#include "Algo/BinarySearch.h"
+
+#if WITH_EDITOR
+#include "DirectoryWatcherModule.h"
+#include "IDirectoryWatcher.h"
+#endif
 
 UGameManager::UGameManager()
 	: CurrentPrefix(0),
-	  EnergyConsumption(0.0)
+	  EnergyConsumption(0.0),
+	  EnergyDirty(true),
+	  UntrackedEnergySource(INDEX_NONE),
+	  EconomyEnergySource(INDEX_NONE),
+	  DisplayedEnergy(-1),
+	  CatalogueVersion(0),
+	  PlaceholderIcon(NULL),
+	  StartingAssetLoads(false),
+	  LoadedConfig(FGameConfig::GetShared()),
+	  ConfigReloadSerial(0),
+	  EnergyMilestoneCursor(0)
 {
+	Economy = CreateDefaultSubobject<UEconomy>(TEXT("Economy"));
+
+	static ConstructorHelpers::FObjectFinder<UTexture> placeholder(TEXT("/Game/Textures/Icons/Ico_Blank"));
+	PlaceholderIcon = placeholder.Object;
+
+	UntrackedEnergySource = RegisterEnergySource("Untracked");
+	EconomyEnergySource = RegisterEnergySource("Economy");
+
 	LoadBuildings();
 	LoadPrefixes();
 	LoadResources();
 	LoadMilestones();
+	RebuildMilestoneIndex();
+	UpdateEnergy();
 }
 
-TSharedPtr<FJsonObject> UGameManager::GetSettingsJson()
+void UGameManager::PostInitProperties()
 {
-	FString jsonFile = FPaths::ProjectConfigDir() + TEXT("GameConfig.json"), jsonStr;
+	Super::PostInitProperties();
+
+#if WITH_EDITOR
+	if (!HasAnyFlags(RF_ClassDefaultObject))
+	{
+		auto& watcher = FModuleManager::LoadModuleChecked<FDirectoryWatcherModule>("DirectoryWatcher");
 
-	if (!FFileHelper::LoadFileToString(jsonStr, *jsonFile))
-		throw std::exception("Building JSON file not found");
+		if (watcher.Get())
+		{
+			watcher.Get()->RegisterDirectoryChangedCallback_Handle(FPaths::GetPath(FGameConfig::GetJsonPath()),
+				IDirectoryWatcher::FDirectoryChanged::CreateUObject(this, &UGameManager::OnConfigFilesChanged), ConfigWatcherHandle);
+		}
+	}
+#endif
+}
 
-	TSharedPtr<FJsonObject> json;
-	TSharedRef<TJsonReader<TCHAR>> reader = TJsonReaderFactory<TCHAR>::Create(jsonStr);
+void UGameManager::BeginDestroy()
+{
+#if WITH_EDITOR
+	if (ConfigWatcherHandle.IsValid())
+	{
+		if (auto watcher = FModuleManager::GetModulePtr<FDirectoryWatcherModule>("DirectoryWatcher"))
+			watcher->Get()->UnregisterDirectoryChangedCallback_Handle(FPaths::GetPath(FGameConfig::GetJsonPath()), ConfigWatcherHandle);
 
-	if (!FJsonSerializer::Deserialize(reader, json))
-		throw std::exception("Error parsing JSON");
+		ConfigWatcherHandle.Reset();
+	}
+#endif
 
-	return json;
+	Super::BeginDestroy();
 }
 
-void UGameManager::LoadBuildings()
+/* Asset load priorities, highest first */
+static const int32 PriorityVisible = FStreamableManager::AsyncLoadHighPriority;
+static const int32 PriorityUnlockedIcon = 75;
+static const int32 PriorityUnlockedBlueprint = 50;
+static const int32 PriorityLockedIcon = 25;
+static const int32 PriorityLockedBlueprint = FStreamableManager::DefaultAsyncLoadPriority;
+
+/* Loads handed to the stream at once, the rest wait in AssetQueue where their order can still change */
+static const int32 MaxAssetLoads = 8;
+
+bool UGameManager::CreateBuildingDesc(const FBuildingConfig& config, FBuildingDesc& item)
 {
-	auto json = GetSettingsJson();
-	auto buildings = json->GetArrayField("Buildings");
+	FString building = config.Name;
+	building.ReplaceInline(L" ", L"");
 
-	IFileManager& fileManager = IFileManager::Get();
+	if (building.IsEmpty())
+		return false;
 
-	for (auto b : buildings)
-	{
-		auto fields = b->AsObject();
+	// Only paths here, the assets themselves are streamed in once the entry is registered
+	FString base = TEXT("/Game/Models/Buildings/") + building + "/" + building;
+
+	item.IconAsset = TSoftObjectPtr<UTexture>(FSoftObjectPath(base + "_Ico." + building + "_Ico"));
+	item.BuildingClass = TSoftClassPtr<AActor>(FSoftObjectPath(base + "_BP." + building + "_BP_C"));
+
+	FSlateBrush brush;
+	brush.ImageSize = FVector2D(128.0f, 128.0f);
+	brush.SetResourceObject(PlaceholderIcon);
+
+	item.Name = config.Name;
+	item.Icon = brush;
+	item.Unlocked = config.Unlocked;
+	item.BuildersRequired = config.NumBuilders;
+	item.HP = config.HP;
+	item.Building = NULL;
 
-		FString building = fields->GetStringField("Name");
-		building.ReplaceInline(L" ", L"");
+	for (int32 i = 0; i < ARRAY_COUNT(config.Resources); ++i)
+		item.ResourcesRequired[(EResourceType)i] = config.Resources[i];
 
-		FString base = TEXT("/Game/Models/Buildings/");
-		FString assetBase = FPaths::ProjectContentDir() + TEXT("Models/Buildings/") + building + "/" + building;
-		FString texPath = building + "/" + building + "_Ico";
-		FString bpPath = building + "/" + building + "_BP";
+	return true;
+}
+
+void UGameManager::RequestBuildingAssets(int32 index, bool prioritise)
+{
+	// The CDO only needs the catalogue, never the assets
+	if (HasAnyFlags(RF_ClassDefaultObject))
+		return;
+
+	FBuildingDesc& item = Buildings[index];
+
+	// Already resident, e.g. loaded by another manager
+	if (item.IconAsset.IsValid())
+		item.Icon.SetResourceObject(item.IconAsset.Get());
+	else if (!item.IconAsset.IsNull())
+		RequestAsset(item.IconAsset.ToSoftObjectPath(), item.Name, prioritise ? PriorityVisible : item.Unlocked ? PriorityUnlockedIcon : PriorityLockedIcon);
+
+	if (item.BuildingClass.IsValid())
+		item.Building = item.BuildingClass.Get();
+	else if (!item.BuildingClass.IsNull())
+		RequestAsset(item.BuildingClass.ToSoftObjectPath(), item.Name, prioritise ? PriorityVisible : item.Unlocked ? PriorityUnlockedBlueprint : PriorityLockedBlueprint);
+}
 
-		if (!fileManager.FileExists(*(assetBase + "_Ico.uasset")))
+void UGameManager::RequestAsset(const FSoftObjectPath& path, const FString& building, int32 priority)
+{
+	auto higherPriority = [this](const FSoftObjectPath& a, const FSoftObjectPath& b) { return AssetRequests[a].Priority > AssetRequests[b].Priority; };
+
+	if (FAssetRequest* request = AssetRequests.Find(path))
+	{
+		request->Buildings.AddUnique(building);
+
+		// The stream keeps the priority a load started with, only queued ones can move
+		if (!request->Handle.IsValid() && priority > request->Priority)
 		{
-			UE_LOG(LogTemp, Warning, TEXT("Could not find texture for %s"), *building);
+			request->Priority = priority;
+			AssetQueue.Heapify(higherPriority);
+		}
+
+		return;
+	}
+
+	FAssetRequest& request = AssetRequests.Add(path);
+	request.Priority = priority;
+	request.Buildings.Add(building);
+
+	AssetQueue.HeapPush(path, higherPriority);
+	StartAssetLoads();
+}
+
+void UGameManager::StartAssetLoads()
+{
+	// Loads can complete inside RequestAsyncLoad, the outer loop carries on for them
+	if (StartingAssetLoads)
+		return;
+
+	StartingAssetLoads = true;
+
+	auto higherPriority = [this](const FSoftObjectPath& a, const FSoftObjectPath& b) { return AssetRequests[a].Priority > AssetRequests[b].Priority; };
+
+	while (AssetQueue.Num() > 0 && AssetRequests.Num() - AssetQueue.Num() < MaxAssetLoads)
+	{
+		FSoftObjectPath path;
+		AssetQueue.HeapPop(path, higherPriority, false);
+
+		auto handle = Streamable.RequestAsyncLoad(path, FStreamableDelegate::CreateUObject(this, &UGameManager::OnBuildingAssetLoaded, path), AssetRequests[path].Priority);
+
+		if (!handle.IsValid())
+			OnBuildingAssetLoaded(path);
+		else if (FAssetRequest* request = AssetRequests.Find(path))
+			request->Handle = handle;
+	}
+
+	StartingAssetLoads = false;
+}
+
+void UGameManager::OnBuildingAssetLoaded(FSoftObjectPath path)
+{
+	FAssetRequest request;
+
+	if (!AssetRequests.RemoveAndCopyValue(path, request))
+		return;
+
+	for (const FString& name : request.Buildings)
+	{
+		// Dropped by a config reload while loading
+		const int32* index = BuildingIndices.Find(name);
+
+		if (!index)
 			continue;
+
+		FBuildingDesc& item = Buildings[*index];
+
+		if (item.IconAsset.ToSoftObjectPath() == path)
+		{
+			if (item.IconAsset.IsValid())
+				item.Icon.SetResourceObject(item.IconAsset.Get());
+			else
+				UE_LOG(LogTemp, Warning, TEXT("Could not find texture for %s"), *item.Name);
 		}
 
-		if (!fileManager.FileExists(*(assetBase + "_BP.uasset")))
+		if (item.BuildingClass.ToSoftObjectPath() == path)
 		{
-			UE_LOG(LogTemp, Warning, TEXT("Could not find model blueprint for %s"), *building);
-			continue;
+			if (item.BuildingClass.IsValid())
+				item.Building = item.BuildingClass.Get();
+			else
+				UE_LOG(LogTemp, Warning, TEXT("Could not find model blueprint for %s"), *item.Name);
 		}
+	}
 
-		auto tex = ConstructorHelpers::FObjectFinder<UTexture>(*(base + texPath));
-		auto bp = ConstructorHelpers::FObjectFinder<UBlueprint>(*(base + bpPath));
+	++CatalogueVersion;
+	StartAssetLoads();
+}
 
-		if (!tex.Succeeded()) continue;
-		if (!bp.Succeeded())  continue;
+void UGameManager::PrioritiseBuildingAssets(const TArray<int>& indices)
+{
+	for (int index : indices)
+	{
+		if (Buildings.IsValidIndex(index))
+			RequestBuildingAssets(index, true);
+	}
+}
 
-		FSlateBrush brush;
-		brush.ImageSize = FVector2D(128.0f, 128.0f);
-		brush.SetResourceObject(tex.Object);
+bool UGameManager::AreBuildingAssetsLoaded(int index) const
+{
+	return Buildings.IsValidIndex(index) && Buildings[index].IconAsset.IsValid() && Buildings[index].Building != NULL;
+}
 
+void UGameManager::LoadBuildings()
+{
+	for (auto& config : LoadedConfig->Buildings)
+	{
 		FBuildingDesc item;
-		item.Name = fields->GetStringField("Name");
-		item.Icon = brush;
-		item.Unlocked = fields->HasField("Unlocked") ? fields->GetBoolField("Unlocked") : false;
-		item.BuildersRequired = fields->GetIntegerField("NumBuilders");
-		item.HP = fields->GetIntegerField("HP");
-
-		item.ResourcesRequired[EResourceType::Wood]	   = fields->HasField("ResWood")    ? fields->GetIntegerField("ResWood") : 0;
-		item.ResourcesRequired[EResourceType::Metal]   = fields->HasField("ResMetal")   ? fields->GetIntegerField("ResMetal") : 0;
-		item.ResourcesRequired[EResourceType::Coal]	   = fields->HasField("ResCoal")    ? fields->GetIntegerField("ResCoal") : 0;
-		item.ResourcesRequired[EResourceType::Oil]     = fields->HasField("ResOil")     ? fields->GetIntegerField("ResOil") : 0;
-		item.ResourcesRequired[EResourceType::Silicon] = fields->HasField("ResSilicon") ? fields->GetIntegerField("ResSilicon") : 0;
-
-		if (bp.Object != NULL)
-			item.Building = bp.Object->GeneratedClass;
-		else
-		{
-			UE_LOG(LogTemp, Warning, TEXT("Error loading class for"), *building);
-			continue;
-		}
 
-		Buildings.Add(item.Name, item);
+		if (CreateBuildingDesc(config, item))
+			AddBuilding(item);
+	}
+}
+
+int32 UGameManager::AddBuilding(const FBuildingDesc& item)
+{
+	int32 index = Buildings.Add(item);
+
+	BuildingIndices.Add(item.Name, index);
+	BuildingRequirements.AddUninitialized();
+	UpdateRequirements(index);
+	RequestBuildingAssets(index);
+
+	++CatalogueVersion;
+	return index;
+}
+
+void UGameManager::UpdateRequirements(int32 index)
+{
+	FBuildingRequirements& requirements = BuildingRequirements[index];
+	FMemory::Memzero(requirements.Resources);
+
+	for (auto& res : Buildings[index].ResourcesRequired)
+		requirements.Resources[(int32)res.Key] = res.Value;
+}
+
+void UGameManager::RebuildBuildingIndices()
+{
+	BuildingIndices.Reset();
+	BuildingRequirements.SetNumUninitialized(Buildings.Num());
+
+	for (int32 i = 0; i < Buildings.Num(); ++i)
+	{
+		BuildingIndices.Add(Buildings[i].Name, i);
+		UpdateRequirements(i);
 	}
+
+	++CatalogueVersion;
 }
 
 void UGameManager::LoadPrefixes()
 {
-	auto json = GetSettingsJson();
-	auto prefixes = json->GetArrayField("Prefixes");
+	TArray<FPrefixConfig> prefixes = LoadedConfig->Prefixes;
+	prefixes.Sort([](const FPrefixConfig& a, const FPrefixConfig& b) { return a.Power < b.Power; });
+
+	PrefixThresholds.Reset();
+	PrefixNames.Reset();
+
+	for (auto& prefix : prefixes)
+	{
+		PrefixThresholds.Add(FMath::Pow(10.0, (double)prefix.Power));
+		PrefixNames.Add(prefix.Short);
+	}
 
-	for(auto prefix : prefixes)
+	if (PrefixThresholds.Num() == 0)
 	{
-		auto obj = prefix->AsObject();
-		Prefixes.Add(obj->GetNumberField("Power"), obj->GetStringField("Short"));
+		PrefixThresholds.Add(1.0);
+		PrefixNames.Add(FString());
 	}
 }
 
 void UGameManager::LoadResources()
 {
-	Resources.Add(EResourceType::Wood, FResource(1000, true));
-	Resources.Add(EResourceType::Metal, FResource());
-	Resources.Add(EResourceType::Coal, FResource());
-	Resources.Add(EResourceType::Oil, FResource());
-	Resources.Add(EResourceType::Silicon, FResource());
+	Economy->AddAmount(EResourceType::Wood, 1000);
+	Economy->Unlock(EResourceType::Wood);
 }
 
 void UGameManager::LoadMilestones()
 {
-	auto json = GetSettingsJson();
-	auto milestones = json->GetArrayField("Milestones");
+	for (auto& milestone : LoadedConfig->Milestones)
+	{
+		FGameEvent evt;
+		evt.Type = milestone.Type;
+		evt.Name = milestone.Name;
+		evt.Data = milestone.Data;
+		evt.EnergyConsumption = milestone.EnergyRequired;
+
+		Milestones.Add(evt);
+	}
+}
+
+#if WITH_EDITOR
+void UGameManager::OnConfigFilesChanged(const TArray<FFileChangeData>& changes)
+{
+	const FString file = FPaths::GetCleanFilename(FGameConfig::GetJsonPath());
+
+	if (changes.ContainsByPredicate([&file](const FFileChangeData& change) { return FPaths::GetCleanFilename(change.Filename) == file; }))
+		ReloadConfig();
+}
+#endif
+
+void UGameManager::ReloadConfig()
+{
+	// Editors often write a file several times per save, only the newest parse is applied
+	const uint32 serial = ++ConfigReloadSerial;
+	TWeakObjectPtr<UGameManager> weakThis(this);
 
-	for (auto milestone : milestones)
+	Async<void>(EAsyncExecution::ThreadPool, [weakThis, serial]()
 	{
-		auto obj = milestone->AsObject();
-		auto type = obj->GetStringField("Event");
+		double begin = FPlatformTime::Seconds();
 
-		FGameEvent evt;
-		
-		if (type == "UnlockBuilding")	evt.Type = EEvent::UnlockBuilding;
-		if (type == "UnlockTechnology") evt.Type = EEvent::UnlockTechnology;
-		if (type == "Achievement")		evt.Type = EEvent::Achievement;
+		TSharedRef<FGameConfig, ESPMode::ThreadSafe> config = MakeShareable(new FGameConfig());
+		FString error;
+
+		if (!config->LoadJson(FGameConfig::GetJsonPath(), error))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Game config reload failed, keeping the current one: %s"), *error);
+			return;
+		}
 
-		evt.Name = obj->GetStringField("Name");
-		evt.Data = obj->GetStringField("Data");
-		evt.EnergyConsumption = obj->GetIntegerField("EnergyRequired");
+		double parseTime = (FPlatformTime::Seconds() - begin) * 1000.0;
 
-		Milestones.Add(evt);
+		AsyncTask(ENamedThreads::GameThread, [weakThis, serial, config, parseTime]()
+		{
+			UGameManager* manager = weakThis.Get();
+
+			if (!manager || serial != manager->ConfigReloadSerial)
+				return;
+
+			auto previous = manager->LoadedConfig;
+
+			FGameConfig::Replace(config);
+			manager->LoadedConfig = config;
+			manager->ApplyConfig(*previous, *config);
+
+			UE_LOG(LogTemp, Log, TEXT("Reloaded game config (parsed in %.2fms off the game thread)"), parseTime);
+		});
+	});
+}
+
+void UGameManager::ApplyConfig(const FGameConfig& previous, const FGameConfig& next)
+{
+	int32 added = 0, changed = 0, removed = 0;
+
+	/* Buildings: unlock state and loaded assets survive, only the tuning values are replaced */
+	TMap<FString, const FBuildingConfig*> oldBuildings;
+
+	for (auto& building : previous.Buildings)
+		oldBuildings.Add(building.Name, &building);
+
+	TSet<FString> nextBuildings;
+
+	for (auto& config : next.Buildings)
+	{
+		nextBuildings.Add(config.Name);
+
+		const FBuildingConfig** old = oldBuildings.Find(config.Name);
+
+		if (old && **old == config)
+			continue;
+
+		const int32* index = BuildingIndices.Find(config.Name);
+
+		if (index)
+		{
+			FBuildingDesc* item = &Buildings[*index];
+
+			item->BuildersRequired = config.NumBuilders;
+			item->HP = config.HP;
+
+			for (int32 i = 0; i < ARRAY_COUNT(config.Resources); ++i)
+				item->ResourcesRequired[(EResourceType)i] = config.Resources[i];
+
+			// A building newly marked as unlocked by default is unlocked, but a live unlock is never taken back
+			item->Unlocked |= config.Unlocked;
+			UpdateRequirements(*index);
+			++CatalogueVersion;
+			++changed;
+		}
+		else
+		{
+			FBuildingDesc desc;
+
+			if (CreateBuildingDesc(config, desc))
+			{
+				AddBuilding(desc);
+				++added;
+			}
+		}
+	}
+
+	int32 removedBuildings = Buildings.RemoveAll([&nextBuildings](const FBuildingDesc& item) { return !nextBuildings.Contains(item.Name); });
+
+	if (removedBuildings > 0)
+	{
+		RebuildBuildingIndices();
+		removed += removedBuildings;
+	}
+
+	/* Milestones: completed ones stay completed, pending ones are added, updated or dropped */
+	TSet<FString> nextMilestones;
+
+	for (auto& config : next.Milestones)
+	{
+		nextMilestones.Add(config.Name);
+
+		if (CompletedMilestones.ContainsByPredicate([&config](const FGameEvent& evt) { return evt.Name == config.Name; }))
+			continue;
+
+		FGameEvent* evt = Milestones.FindByPredicate([&config](const FGameEvent& e) { return e.Name == config.Name; });
+
+		if (!evt)
+		{
+			evt = &Milestones.AddDefaulted_GetRef();
+			evt->Name = config.Name;
+			++added;
+		}
+		else if (evt->Type != config.Type || evt->Data != config.Data || evt->EnergyConsumption != config.EnergyRequired)
+			++changed;
+
+		evt->Type = config.Type;
+		evt->Data = config.Data;
+		evt->EnergyConsumption = config.EnergyRequired;
+	}
+
+	removed += Milestones.RemoveAll([&nextMilestones](const FGameEvent& evt) { return !nextMilestones.Contains(evt.Name); });
+	RebuildMilestoneIndex();
+
+	/* Prefixes: a handful of entries, rebuilt whenever any of them changed */
+	if (previous.Prefixes != next.Prefixes)
+	{
+		LoadPrefixes();
+
+		CurrentPrefix = 0;
+		DisplayedEnergy = -1;
+		EnergyDirty = true;
+		++changed;
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Applied game config: %d added, %d changed, %d removed"), added, changed, removed);
+}
+
+void UGameManager::RebuildMilestoneIndex()
+{
+	MilestoneHandles.Reset();
+	MilestoneCompleted.Init(false, Milestones.Num());
+	EnergyMilestones.Reset();
+	EnergyMilestoneCursor = 0;
+	PendingMilestones.Reset();
+
+	for (auto& handles : MilestonesByType)
+		handles.Reset();
+
+	TSet<FString> completed;
+
+	for (auto& milestone : CompletedMilestones)
+		completed.Add(milestone.Name);
+
+	for (int32 i = 0; i < Milestones.Num(); ++i)
+	{
+		const FGameEvent& milestone = Milestones[i];
+
+		MilestoneHandles.Add(milestone.Name, i);
+		MilestonesByType[(int32)milestone.Type].Add(i);
+		MilestoneCompleted[i] = completed.Contains(milestone.Name);
+
+		if (milestone.EnergyConsumption > 0 && !MilestoneCompleted[i])
+			EnergyMilestones.Add(i);
+	}
+
+	EnergyMilestones.StableSort([this](int32 a, int32 b) { return Milestones[a].EnergyConsumption < Milestones[b].EnergyConsumption; });
+
+	// Thresholds already passed before a reload are picked up straight away
+	AdvanceEnergyMilestones();
+}
+
+void UGameManager::AdvanceEnergyMilestones()
+{
+	while (EnergyMilestoneCursor < EnergyMilestones.Num())
+	{
+		int32 handle = EnergyMilestones[EnergyMilestoneCursor];
+
+		if (EnergyConsumption < Milestones[handle].EnergyConsumption)
+			break;
+
+		if (!MilestoneCompleted[handle])
+			PendingMilestones.Add(handle);
+
+		++EnergyMilestoneCursor;
 	}
 }
 
 void UGameManager::Tick(float dt)
 {
-	for(auto milestone : Milestones)
+	UWorld* world = HasAnyFlags(RF_ClassDefaultObject) ? NULL : GetWorld();
+
+	// Buildings only produce and draw in a running game, never in editor worlds or while paused
+	if (world && world->IsGameWorld() && !world->IsPaused())
 	{
-		if(milestone.EnergyConsumption > 0 && EnergyConsumption >= milestone.EnergyConsumption)
-			CompleteMilestone(milestone.Name);
+		if (Economy->GetNumBuildings() > 0)
+			Economy->Advance(dt);
+
+		// Absolute draw, the economy zeroes it when the last building is removed
+		SetEnergySource(EconomyEnergySource, Economy->GetEnergyDraw());
 	}
+
+	if (EnergyDirty)
+		UpdateEnergy();
+
+	if (PendingMilestones.Num() == 0)
+		return;
+
+	// Completing one can trigger Blueprint that reaches another, so work on a copy
+	TArray<int32> pending = MoveTemp(PendingMilestones);
+
+	for (int32 handle : pending)
+		CompleteMilestoneByHandle(handle);
 }
 
 void UGameManager::CompleteMilestone(FString name)
 {
-	for (auto milestone : Milestones)
+	const int32* handle = MilestoneHandles.Find(name);
+
+	if (!handle)
 	{
-		if(milestone.Name == name)
-		{
-			CompletedMilestones.Add(milestone);
-			Milestones.Remove(milestone);
-			OnMilestoneCompleted(milestone);
+		UE_LOG(LogTemp, Error, TEXT("Milestone '%s' does not exist"), *name);
+		return;
+	}
 
-			return;
-		}
+	CompleteMilestoneByHandle(*handle);
+}
+
+int UGameManager::GetMilestoneHandle(FString milestone) const
+{
+	const int32* handle = MilestoneHandles.Find(milestone);
+	return handle ? *handle : INDEX_NONE;
+}
+
+void UGameManager::CompleteMilestoneByHandle(int handle)
+{
+	if (!Milestones.IsValidIndex(handle))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Milestone handle %d does not exist"), handle);
+		return;
 	}
-	
-	if(CompletedMilestones.FindByPredicate([name](FGameEvent evt) { return evt.Name == name; }) == NULL)
-		UE_LOG(LogTemp, Error, TEXT("Milestone '%s' does not exist"), *name);
+
+	if (MilestoneCompleted[handle])
+		return;
+
+	MilestoneCompleted[handle] = true;
+	CompletedMilestones.Add(Milestones[handle]);
+	OnMilestoneCompleted(Milestones[handle]);
+}
+
+bool UGameManager::IsMilestoneCompleted(int handle) const
+{
+	return Milestones.IsValidIndex(handle) && MilestoneCompleted[handle];
+}
+
+TArray<FGameEvent> UGameManager::GetMilestonesOfType(EEvent type) const
+{
+	TArray<FGameEvent> milestones;
+
+	for (int32 handle : MilestonesByType[(int32)type])
+		milestones.Add(Milestones[handle]);
+
+	return milestones;
 }
 
 void UGameManager::AddEnergyConsumption(float watts)
 {
-	EnergyConsumption += watts;
+	EnergySources[UntrackedEnergySource] += watts;
+	EnergyDirty = true;
+}
 
-	for(auto power : Prefixes)
+int UGameManager::RegisterEnergySource(FName category)
+{
+	if (FreeEnergySources.Num() > 0)
 	{
-		if (EnergyConsumption >= pow(10.0, power.Key))
-			CurrentPrefix = power.Key;
+		int32 source = FreeEnergySources.Pop(false);
+		EnergyCategories[source] = category;
+		return source;
 	}
+
+	EnergyCategories.Add(category);
+	return EnergySources.Add(0.0);
 }
 
-FString UGameManager::GetFormattedEnergyConsumption()
+void UGameManager::SetEnergySource(int source, float watts)
 {
-	double adj = static_cast<int>(EnergyConsumption / pow(10.0, CurrentPrefix));
-	return FString::FromInt(adj) + Prefixes[CurrentPrefix] + 'W';
+	if (!EnergySources.IsValidIndex(source) || EnergyCategories[source] == NAME_None || EnergySources[source] == (double)watts)
+		return;
+
+	EnergySources[source] = watts;
+	EnergyDirty = true;
 }
 
-void UGameManager::AddResourceAmount(TMap<EResourceType, int> res)
+void UGameManager::RemoveEnergySource(int source)
 {
-	for (auto r : res)
-		Resources[r.Key] += r.Value;
+	if (!EnergySources.IsValidIndex(source) || EnergyCategories[source] == NAME_None)
+		return;
+
+	// AddEnergyConsumption and the economy write to these by handle, a recycled slot would take their watts
+	if (source == UntrackedEnergySource || source == EconomyEnergySource)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Energy source %d is built in and can't be removed"), source);
+		return;
+	}
+
+	EnergySources[source] = 0.0;
+	EnergyCategories[source] = NAME_None;
+	FreeEnergySources.Add(source);
+	EnergyDirty = true;
 }
 
-void UGameManager::SubtractResourceAmount(TMap<EResourceType, int> res)
+float UGameManager::GetCategoryEnergyConsumption(FName category)
 {
-	for (auto r : res)
-		Resources[r.Key] -= r.Value;
+	const double* watts = CategoryEnergy.Find(category);
+	return watts ? (float)*watts : 0.0f;
 }
 
-bool UGameManager::CanPlaceBuilding(FBuildingDesc building)
+void UGameManager::UpdateEnergy()
 {
-	for(auto res : building.ResourcesRequired)
+	EnergyDirty = false;
+
+	double total = 0.0;
+	CategoryEnergy.Reset();
+
+	for (int32 i = 0; i < EnergySources.Num(); ++i)
+	{
+		if (EnergyCategories[i] == NAME_None)
+			continue;
+
+		total += EnergySources[i];
+		CategoryEnergy.FindOrAdd(EnergyCategories[i]) += EnergySources[i];
+	}
+
+	EnergyConsumption = total;
+	AdvanceEnergyMilestones();
+
+	// Largest prefix whose threshold has been reached, or the smallest one below that
+	int32 prefix = FMath::Max(0, Algo::UpperBound(PrefixThresholds, total) - 1);
+	int64 displayed = (int64)(total / PrefixThresholds[prefix]);
+
+	if (displayed != DisplayedEnergy || prefix != CurrentPrefix)
 	{
-		if (Resources[res.Key]() < res.Value)
+		CurrentPrefix = prefix;
+		DisplayedEnergy = displayed;
+		FormattedEnergy = FString::Printf(TEXT("%lld%sW"), displayed, *PrefixNames[CurrentPrefix]);
+	}
+}
+
+void UGameManager::AddSingleResourceAmount(EResourceType res, int val)
+{
+	Economy->AddAmount(res, val);
+}
+
+void UGameManager::AddResourceAmount(const TMap<EResourceType, int>& res)
+{
+	Economy->AddAmounts(res);
+}
+
+void UGameManager::SubtractResourceAmount(const TMap<EResourceType, int>& res)
+{
+	Economy->SubtractAmounts(res);
+}
+
+int UGameManager::GetResourceAmount(EResourceType res)
+{
+	return Economy->GetAmount(res);
+}
+
+void UGameManager::UnlockResource(EResourceType res)
+{
+	Economy->Unlock(res);
+}
+
+bool UGameManager::IsResourceUnlocked(EResourceType res)
+{
+	return Economy->IsUnlocked(res);
+}
+
+bool UGameManager::CanPlaceBuilding(const FBuildingDesc& building)
+{
+	const int32* index = BuildingIndices.Find(building.Name);
+
+	if (index)
+		return CanPlaceBuildingByIndex(*index);
+
+	for (auto& res : building.ResourcesRequired)
+	{
+		if (Economy->GetAmount(res.Key) < res.Value)
 			return false;
 	}
 
 	return true;
 }
 
+bool UGameManager::CanPlaceBuildingByIndex(int index)
+{
+	if (!BuildingRequirements.IsValidIndex(index))
+		return false;
+
+	const int32* required = BuildingRequirements[index].Resources;
+	const int32* available = Economy->GetAmounts();
+
+	// Every resource in two compares, any lane where required > available means it can't be afforded
+	VectorRegisterInt low = VectorIntCompareGT(VectorIntLoad(required), VectorIntLoad(available));
+	VectorRegisterInt high = VectorIntCompareGT(VectorIntLoad(required + 4), VectorIntLoad(available + 4));
+
+	int32 lanes[4];
+	VectorIntStore(VectorIntOr(low, high), lanes);
+
+	return (lanes[0] | lanes[1] | lanes[2] | lanes[3]) == 0;
+}
+
+void UGameManager::UnlockBuilding(const FBuildingDesc& building)
+{
+	const int32* index = BuildingIndices.Find(building.Name);
+
+	if (index && !Buildings[*index].Unlocked)
+	{
+		Buildings[*index].Unlocked = true;
+		RequestBuildingAssets(*index);
+		++CatalogueVersion;
+	}
+}
+
 TArray<FBuildingDesc> UGameManager::GetBuildingList()
 {
-	TArray<FBuildingDesc> list;
-	Buildings.GenerateValueArray(list);
-	return list;
-}
\ No newline at end of file
+	return Buildings;
+}
+
+bool UGameManager::GetBuildingListIfChanged(int& version, TArray<FBuildingDesc>& list)
+{
+	if ((uint32)version == CatalogueVersion)
+		return false;
+
+	list = Buildings;
+	version = (int)CatalogueVersion;
+	return true;
+}
+
+int UGameManager::GetBuildingIndex(FString name) const
+{
+	const int32* index = BuildingIndices.Find(name);
+	return index ? *index : INDEX_NONE;
+}
+
+void UGameManager::SaveProgress(FGameProgress& progress) const
+{
+	const int32* amounts = Economy->GetAmounts();
+
+	progress.UnlockedResources = 0;
+
+	for (int32 i = 0; i < MaxResourceTypes; ++i)
+	{
+		progress.Resources[i] = amounts[i];
+
+		if (Economy->IsUnlocked((EResourceType)i))
+			progress.UnlockedResources |= 1 << i;
+	}
+
+	progress.UnlockedBuildings.Reset();
+
+	for (auto& building : Buildings)
+	{
+		if (building.Unlocked)
+			progress.UnlockedBuildings.Add(building.Name);
+	}
+
+	progress.CompletedMilestones.Reset();
+
+	for (auto& milestone : CompletedMilestones)
+		progress.CompletedMilestones.Add(milestone.Name);
+
+	progress.UntrackedEnergy = EnergySources[UntrackedEnergySource];
+}
+
+void UGameManager::ClearBuildingState()
+{
+	Economy->RemoveAllBuildings();
+
+	for (int32 i = 0; i < EnergySources.Num(); ++i)
+	{
+		if (i != UntrackedEnergySource && i != EconomyEnergySource && EnergyCategories[i] != NAME_None)
+			RemoveEnergySource(i);
+	}
+
+	SetEnergySource(EconomyEnergySource, 0.0f);
+}
+
+void UGameManager::LoadProgress(const FGameProgress& progress)
+{
+	const int32* amounts = Economy->GetAmounts();
+
+	// The save holds every unlock, so anything unlocked since it was made is taken back
+	for (int32 i = 0; i < MaxResourceTypes; ++i)
+	{
+		Economy->AddAmount((EResourceType)i, progress.Resources[i] - amounts[i]);
+		Economy->SetUnlocked((EResourceType)i, (progress.UnlockedResources & (1 << i)) != 0);
+	}
+
+	// Buildings start from the config defaults, which may have gained entries since the save
+	TSet<FString> unlocked(progress.UnlockedBuildings);
+
+	for (auto& config : LoadedConfig->Buildings)
+	{
+		if (config.Unlocked)
+			unlocked.Add(config.Name);
+	}
+
+	for (int32 i = 0; i < Buildings.Num(); ++i)
+	{
+		bool isUnlocked = unlocked.Contains(Buildings[i].Name);
+
+		if (Buildings[i].Unlocked == isUnlocked)
+			continue;
+
+		Buildings[i].Unlocked = isUnlocked;
+		++CatalogueVersion;
+
+		if (isUnlocked)
+			RequestBuildingAssets(i);
+	}
+
+	CompletedMilestones.Reset();
+
+	for (auto& name : progress.CompletedMilestones)
+	{
+		const int32* handle = MilestoneHandles.Find(name);
+
+		if (handle)
+			CompletedMilestones.Add(Milestones[*handle]);
+		else
+			UE_LOG(LogTemp, Warning, TEXT("Saved milestone '%s' no longer exists"), *name);
+	}
+
+	EnergySources[UntrackedEnergySource] = progress.UntrackedEnergy;
+	UpdateEnergy();
+
+	// Energy thresholds the loaded total already passes are completed on the next Tick
+	RebuildMilestoneIndex();
+}
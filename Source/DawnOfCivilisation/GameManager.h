@@ -6,8 +6,11 @@
 #include "Building.h"
 #include "SlateBrush.h"
 #include "Json.h"
+#include "Engine/StreamableManager.h"
 #include "GameManager.generated.h"
 
+class UTexture;
+
 UENUM(BlueprintType)
 enum class EEvent : uint8
 {
@@ -26,6 +29,9 @@ enum class EResourceType : uint8
 	Silicon		 UMETA(DisplayName = "Silicon")
 };
 
+/* Room for every EResourceType, padded to two SIMD registers */
+static const int32 MaxResourceTypes = 8;
+
 USTRUCT(BlueprintType)
 struct FGameEvent
 {
@@ -66,6 +72,13 @@ struct FBuildingDesc
 	UPROPERTY(BlueprintReadWrite)
 	TSubclassOf<AActor> Building;
 
+	/* Streamed in after registration, Icon shows a placeholder and Building is null until then */
+	UPROPERTY(BlueprintReadOnly)
+	TSoftObjectPtr<UTexture> IconAsset;
+
+	UPROPERTY(BlueprintReadOnly)
+	TSoftClassPtr<AActor> BuildingClass;
+
 	UPROPERTY(BlueprintReadWrite)
 	TMap<EResourceType, int> ResourcesRequired;
 
@@ -90,6 +103,12 @@ struct FBuildingDesc
 	}
 };
 
+/* FBuildingDesc::ResourcesRequired flattened to an array indexed by EResourceType */
+struct FBuildingRequirements
+{
+	int32 Resources[MaxResourceTypes];
+};
+
 USTRUCT(BlueprintType)
 struct FResource
 {
@@ -114,6 +133,20 @@ struct FResource
 	int operator()() { return Amount; }
 };
 
+/* An icon or blueprint the catalogue wants, shared by every building that names the same asset */
+struct FAssetRequest
+{
+	int32 Priority;
+	TArray<FString> Buildings;
+
+	/* Unset while the request is still queued */
+	TSharedPtr<FStreamableHandle> Handle;
+};
+
+struct FGameConfig;
+struct FBuildingConfig;
+struct FGameProgress;
+
 UCLASS(Blueprintable)
 class DAWNOFCIVILISATION_API UGameManager : public UObject, public FTickableGameObject
 {
@@ -122,44 +155,66 @@ class DAWNOFCIVILISATION_API UGameManager : public UObject, public FTickableGame
 	public:
 		UGameManager();
 
+		void PostInitProperties() override;
+		void BeginDestroy() override;
+
 		void Tick(float dt) override;
 		bool IsTickable() const override { return true; }
-		bool IsTickableInEditor() const override { return true; }
-		bool IsTickableWhenPaused() const override { return true; }
+		bool IsTickableInEditor() const override { return false; }
+		bool IsTickableWhenPaused() const override { return false; }
 		TStatId GetStatId() const override { return TStatId(); }
 		
 		/* ------ Energy methods ------ */
 
+		/* Adds to the untracked entry of the energy ledger, totals update on the next Tick */
 		UFUNCTION(BlueprintCallable)
 		void AddEnergyConsumption(float watts);
 
+		/* New ledger entry for a building or category, returns its handle */
+		UFUNCTION(BlueprintCallable)
+		int RegisterEnergySource(FName category);
+
 		UFUNCTION(BlueprintCallable)
-		float GetEnergyConsumption() { return EnergyConsumption; }
+		void SetEnergySource(int source, float watts);
 
+		/* Frees the handle for reuse, the built-in Untracked and Economy entries are kept */
 		UFUNCTION(BlueprintCallable)
-		FString GetFormattedEnergyConsumption();
+		void RemoveEnergySource(int source);
+
+		UFUNCTION(BlueprintCallable)
+		float GetEnergyConsumption() { return (float)EnergyConsumption; }
+
+		UFUNCTION(BlueprintCallable)
+		float GetCategoryEnergyConsumption(FName category);
+
+		UFUNCTION(BlueprintCallable)
+		FString GetFormattedEnergyConsumption() { return FormattedEnergy; }
 
 		/* ---------------------------- */
 
 		/* ----- Resource methods ----- */
 
 		UFUNCTION(BlueprintCallable)
-		void AddSingleResourceAmount(EResourceType res, int val) { Resources[res] += val; }
+		void AddSingleResourceAmount(EResourceType res, int val);
+
+		UFUNCTION(BlueprintCallable)
+		void AddResourceAmount(const TMap<EResourceType, int>& res);
 
 		UFUNCTION(BlueprintCallable)
-		void AddResourceAmount(TMap<EResourceType, int> res);
+		void SubtractResourceAmount(const TMap<EResourceType, int>& res);
 
 		UFUNCTION(BlueprintCallable)
-		void SubtractResourceAmount(TMap<EResourceType, int> res);
+		int GetResourceAmount(EResourceType res);
 
 		UFUNCTION(BlueprintCallable)
-		int GetResourceAmount(EResourceType res) { return Resources[res](); }
+		void UnlockResource(EResourceType res);
 
 		UFUNCTION(BlueprintCallable)
-		void UnlockResource(EResourceType res) { Resources[res].IsUnlocked = true; }
+		bool IsResourceUnlocked(EResourceType res);
 
+		/* Stockpile and producing/consuming buildings, register buildings here instead of ticking them */
 		UFUNCTION(BlueprintCallable)
-		bool IsResourceUnlocked(EResourceType res) { return Resources[res].IsUnlocked; }
+		class UEconomy* GetEconomy() { return Economy; }
 
 		/* -----------------------------*/
 
@@ -169,14 +224,37 @@ class DAWNOFCIVILISATION_API UGameManager : public UObject, public FTickableGame
 		bool IsBuildingUnlocked() { return false; }
 
 		UFUNCTION(BlueprintCallable)
-		bool CanPlaceBuilding(FBuildingDesc building);
+		bool CanPlaceBuilding(const FBuildingDesc& building);
 
 		UFUNCTION(BlueprintCallable)
-		void UnlockBuilding(FBuildingDesc building) { Buildings[building.Name].Unlocked = true; }
+		bool CanPlaceBuildingByIndex(int index);
+
+		UFUNCTION(BlueprintCallable)
+		void UnlockBuilding(const FBuildingDesc& building);
 
 		UFUNCTION(BlueprintCallable)
 		TArray<FBuildingDesc> GetBuildingList();
 
+		/* Copies the catalogue into list only if it changed since version, which is then updated */
+		UFUNCTION(BlueprintCallable)
+		bool GetBuildingListIfChanged(UPARAM(ref) int& version, TArray<FBuildingDesc>& list);
+
+		/* Bumped whenever a building is added, removed, unlocked or retuned */
+		UFUNCTION(BlueprintCallable)
+		int GetCatalogueVersion() const { return (int)CatalogueVersion; }
+
+		UFUNCTION(BlueprintCallable)
+		int GetBuildingIndex(FString name) const;
+
+		const TArray<FBuildingDesc>& GetBuildings() const { return Buildings; }
+
+		/* Moves the icons and blueprints of these entries to the front of the load queue, for what the menu is showing */
+		UFUNCTION(BlueprintCallable)
+		void PrioritiseBuildingAssets(const TArray<int>& indices);
+
+		UFUNCTION(BlueprintCallable)
+		bool AreBuildingAssetsLoaded(int index) const;
+
 		/* ---------------------------- */
 
 		/* ----- Milestone methods ---- */
@@ -184,40 +262,139 @@ class DAWNOFCIVILISATION_API UGameManager : public UObject, public FTickableGame
 		UFUNCTION(BlueprintCallable)
 		void CompleteMilestone(FString milestone);
 
+		/* Stable until the config is reloaded, -1 if there is no such milestone */
+		UFUNCTION(BlueprintCallable)
+		int GetMilestoneHandle(FString milestone) const;
+
+		UFUNCTION(BlueprintCallable)
+		void CompleteMilestoneByHandle(int handle);
+
+		UFUNCTION(BlueprintCallable)
+		bool IsMilestoneCompleted(int handle) const;
+
+		UFUNCTION(BlueprintCallable)
+		TArray<FGameEvent> GetMilestonesOfType(EEvent type) const;
+
 		UFUNCTION(BlueprintCallable, BlueprintImplementableEvent)
 		void OnMilestoneCompleted(FGameEvent milestoneEvt);
 
 		/* ---------------------------- */
 
+		/* Re-reads GameConfig.json on a worker thread and applies what changed, runs automatically in the editor when the file is saved */
+		UFUNCTION(BlueprintCallable)
+		void ReloadConfig();
+
+		/* Stockpile, unlocks, untracked energy and completed milestones, for UPlanetSaveGame */
+		void SaveProgress(FGameProgress& progress) const;
+
+		/* Replaces the current progress, milestones are marked completed without firing OnMilestoneCompleted again */
+		void LoadProgress(const FGameProgress& progress);
+
+		/**
+		 * Forgets every economy record and energy source registered by buildings, keeping
+		 * the built-in Untracked and Economy sources. For UPlanetSaveGame, between destroying
+		 * the old buildings and spawning the saved ones that register themselves again.
+		 */
+		void ClearBuildingState();
+
 	private:
+		/* 10^Power of each prefix in ascending order, and its short name */
+		TArray<double> PrefixThresholds;
+		TArray<FString> PrefixNames;
+
+		/* Index into the prefix tables */
 		UPROPERTY()
-		TMap<int, FString> Prefixes;
+		int CurrentPrefix;
 
+		/* Sum of the energy ledger as of the last Tick */
 		UPROPERTY()
-		TMap<EResourceType, FResource> Resources;
+		double EnergyConsumption;
+
+		/* Energy ledger, watts per source; freed entries keep NAME_None until reused */
+		TArray<double> EnergySources;
+		TArray<FName> EnergyCategories;
+		TArray<int32> FreeEnergySources;
+		TMap<FName, double> CategoryEnergy;
+		bool EnergyDirty;
+
+		int32 UntrackedEnergySource;
+		int32 EconomyEnergySource;
+
+		/* Whole units shown with the current prefix, the string is rebuilt only when it changes */
+		int64 DisplayedEnergy;
+		FString FormattedEnergy;
 
 		UPROPERTY()
-		int CurrentPrefix;
+		class UEconomy* Economy;
 
+		/* Building catalogue, addressed by index; BuildingIndices maps names into it */
 		UPROPERTY()
-		float EnergyConsumption;
+		TArray<FBuildingDesc> Buildings;
+
+		TMap<FString, int32> BuildingIndices;
+		TArray<FBuildingRequirements> BuildingRequirements;
+		uint32 CatalogueVersion;
 
 		UPROPERTY()
-		TMap<FString, FBuildingDesc> Buildings;
+		UTexture* PlaceholderIcon;
 
+		FStreamableManager Streamable;
+
+		/* Queued and in-flight loads by asset path, in-flight handles are kept alive until their callback */
+		TMap<FSoftObjectPath, FAssetRequest> AssetRequests;
+
+		/* Paths not yet handed to the stream, a heap on priority so later requests can still overtake them */
+		TArray<FSoftObjectPath> AssetQueue;
+		bool StartingAssetLoads;
+
+		/* Every configured milestone, a handle is an index into this */
 		UPROPERTY()
 		TArray<FGameEvent> Milestones;
 
 		UPROPERTY()
 		TArray<FGameEvent> CompletedMilestones;
 
+		TMap<FString, int32> MilestoneHandles;
+		TBitArray<> MilestoneCompleted;
+		TArray<int32> MilestonesByType[(int32)EEvent::Achievement + 1];
+
+		/* Energy triggered milestones sorted by threshold, everything before the cursor has been reached */
+		TArray<int32> EnergyMilestones;
+		int32 EnergyMilestoneCursor;
+
+		/* Reached while updating the energy total, announced on the next Tick */
+		TArray<int32> PendingMilestones;
+
+		void RebuildMilestoneIndex();
+		void AdvanceEnergyMilestones();
+		void UpdateEnergy();
+
 		/* ------- Load settings ------ */
 
-		TSharedPtr<FJsonObject> GetSettingsJson();
 		void LoadBuildings();
 		void LoadPrefixes();
 		void LoadResources();
 		void LoadMilestones();
 
+		bool CreateBuildingDesc(const FBuildingConfig& config, FBuildingDesc& item);
+		int32 AddBuilding(const FBuildingDesc& item);
+		void UpdateRequirements(int32 index);
+		void RebuildBuildingIndices();
+		void RequestBuildingAssets(int32 index, bool prioritise = false);
+		void RequestAsset(const FSoftObjectPath& path, const FString& building, int32 priority);
+		void StartAssetLoads();
+		void OnBuildingAssetLoaded(FSoftObjectPath path);
+		void ApplyConfig(const FGameConfig& previous, const FGameConfig& next);
+
+		/* Config this manager's state was built from, diffed against on reload */
+		TSharedPtr<const FGameConfig, ESPMode::ThreadSafe> LoadedConfig;
+		uint32 ConfigReloadSerial;
+
+#if WITH_EDITOR
+		void OnConfigFilesChanged(const TArray<struct FFileChangeData>& changes);
+
+		FDelegateHandle ConfigWatcherHandle;
+#endif
+
 		/* ---------------------------- */
 };
@@ -3,6 +3,10 @@
 
 #include "Geosphere.h"
 #include "SimplexNoiseBPLibrary.h"
+#include "PoissonDiscSampling.h"
+#include "ColourSpace.h"
+#include "Async/ParallelFor.h"
+#include "Misc/Paths.h"
 
 #include <map>
 #include <vector>
@@ -23,7 +27,21 @@ AGeosphere::AGeosphere()
 	  OceanDepth(1.0f),
 	  Collidable(true),
 	  GenerateHeights(true),
-	  ReverseCulling(false)
+	  ReverseCulling(false),
+	  VertexColouring(false),
+	  BeachColour(0.88f, 0.31f, 0.10f),
+	  LandColour(0.01f, 0.16f, 0.00f),
+	  MountainColour(0.01f, 0.10f, 0.10f),
+	  BeachLevel(0.05f),
+	  MountainLevel(0.5f),
+	  BandBlend(0.1f),
+	  SlopeStart(25.0f),
+	  SlopeEnd(45.0f),
+	  ColourJitter(0.0f),
+	  JitterFrequency(8.0f),
+	  GeneratedDivisions(0),
+	  VerticesEdited(false),
+	  VertexGridValid(false)
 {
 	PrimaryActorTick.bCanEverTick = false;
 
@@ -44,14 +62,193 @@ void AGeosphere::GetClosestVertices(TArray<int>& indices, TArray<FVector>& verti
 	}
 }
 
+void AGeosphere::CalculateNodeGraph(TMap<float, FNodeGraphSettings> costSettings)
+{
+	// Vertices moved by hand aren't covered by the key, a baked graph would be stale
+	if (VerticesEdited)
+	{
+		NodeGraph->Generate(Vertices, Normals, Indices, costSettings);
+		return;
+	}
+
+	// A planet generated from the same inputs always produces the same graph
+	uint32 key = HashCombine(GetGenerationKey(), UNodeGraph::HashCostSettings(costSettings));
+	FString path = FPaths::ProjectSavedDir() / TEXT("NodeGraphs") / FString::Printf(TEXT("%08X.graph"), key);
+
+	if (NodeGraph->LoadBaked(path, key))
+		return;
+
+	NodeGraph->Generate(Vertices, Normals, Indices, costSettings);
+
+	if (!NodeGraph->SaveBaked(path, key))
+		UE_LOG(LogTemp, Warning, TEXT("Could not save baked node graph to %s"), *path);
+}
+
+TArray<FVector> AGeosphere::ScatterPoints(float minDistance, float minHeight, float maxHeight, float maxSlope, int32 seed)
+{
+	// Heights come from the mesh rather than the noise, whose seed is shared by every geosphere
+	auto filter = [this, minHeight, maxHeight, maxSlope](const FVector& dir)
+	{
+		float height = GetSurfaceHeight(dir);
+		return height >= minHeight && height <= maxHeight && (maxSlope >= 90.0f || GetSlope(dir) <= maxSlope);
+	};
+
+	TArray<FVector> points = UPoissonDiscSampling::GeneratePointsOnSphereNative(Radius, minDistance, filter, seed);
+
+	for (FVector& point : points)
+	{
+		FVector dir = point / Radius;
+		point = dir * (Radius + GetSurfaceHeight(dir));
+	}
+
+	return points;
+}
+
+int32 AGeosphere::FindNearestVertex(const FVector& direction)
+{
+	if (Vertices.Num() == 0)
+		return INDEX_NONE;
+
+	// Average spacing between vertices on the unit sphere
+	const float spacing = FMath::Sqrt(4.0f * PI / Vertices.Num());
+
+	if (!VertexGridValid)
+	{
+		VertexGrid.Reset(spacing * 2.0f);
+
+		for (int32 i = 0; i < Vertices.Num(); ++i)
+			VertexGrid.Add(i, Vertices[i].GetSafeNormal());
+
+		VertexGridValid = true;
+	}
+
+	const FVector dir = direction.GetSafeNormal();
+	int32 nearest = INDEX_NONE;
+	float minDist = MAX_flt;
+
+	for (float radius = spacing * 2.0f; nearest == INDEX_NONE && radius <= 4.0f; radius *= 2.0f)
+	{
+		VertexGrid.ForEachInRadius(dir, radius, [&](int32 i, const FVector& v)
+		{
+			float d = FVector::DistSquared(v, dir);
+
+			if (d < minDist)
+			{
+				nearest = i;
+				minDist = d;
+			}
+		});
+	}
+
+	return nearest;
+}
+
+float AGeosphere::GetSurfaceHeight(FVector direction)
+{
+	int32 vertex = FindNearestVertex(direction);
+	return vertex != INDEX_NONE ? Vertices[vertex].Size() - Radius : 0.0f;
+}
+
+float AGeosphere::GetSlope(FVector direction)
+{
+	int32 vertex = FindNearestVertex(direction);
+
+	if (vertex == INDEX_NONE)
+		return 0.0f;
+
+	// Same measure GenerateVertexColours uses for rock
+	const FVector dir = Vertices[vertex].GetSafeNormal();
+	return FMath::RadiansToDegrees(FMath::Acos(FMath::Min(FMath::Abs(FVector::DotProduct(Normals[vertex], dir)), 1.0f)));
+}
+
+uint32 AGeosphere::GetGenerationKey() const
+{
+	uint32 key = GetTypeHash(Seed);
+	key = HashCombine(key, GetTypeHash(GeneratedDivisions));
+	key = HashCombine(key, GetTypeHash(Vertices.Num()));
+	key = HashCombine(key, GetTypeHash(Radius));
+	key = HashCombine(key, GetTypeHash(NoiseScale));
+	key = HashCombine(key, GetTypeHash(NoiseHeight));
+	key = HashCombine(key, GetTypeHash(Persistence));
+	key = HashCombine(key, GetTypeHash(OceanDepth));
+	key = HashCombine(key, (uint32)GenerateHeights);
+
+	// Edits change the heights and so the graph costs
+	for (const FTerrainEdit& edit : TerrainEdits)
+	{
+		key = HashCombine(key, GetTypeHash(edit.Direction));
+		key = HashCombine(key, GetTypeHash(edit.Radius));
+		key = HashCombine(key, GetTypeHash(edit.Height));
+	}
+
+	return key;
+}
+
 void AGeosphere::GenerateMeshSection()
 {
 	Mesh->CreateMeshSection_LinearColor(0, Vertices, Indices, Normals, UV, VertexColors, Tangents, Collidable);
 }
 
+void AGeosphere::GenerateVertexColours()
+{
+	const int32 num = Vertices.Num();
+	const int32 chunkSize = 1024;
+
+	const float beachHeight = BeachLevel * NoiseHeight;
+	const float mountainHeight = MountainLevel * NoiseHeight;
+	const float blend = BandBlend * NoiseHeight;
+
+	VertexColors.SetNumUninitialized(num);
+
+	ParallelFor(FMath::DivideAndRoundUp(num, chunkSize), [&](int32 chunk)
+	{
+		const int32 first = chunk * chunkSize;
+		const int32 count = FMath::Min(chunkSize, num - first);
+
+		TArray<FVector> colours;
+		colours.SetNumUninitialized(count);
+
+		for (int32 i = 0; i < count; ++i)
+		{
+			const FVector dir = Vertices[first + i].GetSafeNormal();
+			const float height = Vertices[first + i].Size() - Radius;
+			const float slope = FMath::RadiansToDegrees(FMath::Acos(FMath::Min(FMath::Abs(FVector::DotProduct(Normals[first + i], dir)), 1.0f)));
+
+			float land = FMath::SmoothStep(beachHeight, beachHeight + blend, height);
+			float rock = FMath::Max(FMath::SmoothStep(mountainHeight, mountainHeight + blend, height), FMath::SmoothStep(SlopeStart, SlopeEnd, slope));
+
+			FLinearColor colour = FMath::Lerp(FMath::Lerp(BeachColour, LandColour, land), MountainColour, rock);
+			colours[i] = FVector(colour.R, colour.G, colour.B);
+		}
+
+		if (ColourJitter > 0.0f)
+		{
+			UColourSpace::RGBToHSLBatch(colours.GetData(), colours.GetData(), count);
+
+			for (int32 i = 0; i < count; ++i)
+			{
+				const FVector p = Vertices[first + i].GetSafeNormal() * JitterFrequency;
+
+				colours[i].Z += USimplexNoiseBPLibrary::SimplexNoise3D(p.X, p.Y, p.Z) * ColourJitter;
+
+				// HSLToRGB returns greys on a 0-255 scale
+				colours[i].Y = FMath::Max(colours[i].Y, KINDA_SMALL_NUMBER);
+			}
+
+			UColourSpace::HSLToRGBBatch(colours.GetData(), colours.GetData(), count);
+		}
+
+		for (int32 i = 0; i < count; ++i)
+			VertexColors[first + i] = FLinearColor(colours[i].X, colours[i].Y, colours[i].Z, 1.0f);
+	});
+}
+
 void AGeosphere::Generate(float radius, size_t tessellation)
 {
 	USimplexNoiseBPLibrary::setNoiseSeed(Seed);
+	GeneratedDivisions = tessellation;
+	VerticesEdited = false;
+	VertexGridValid = false;
 
 	std::vector<VertexPositionNormalTexture> vertices;
 	std::vector<int32> indices;
@@ -298,29 +495,58 @@ void AGeosphere::Generate(float radius, size_t tessellation)
 
 	ClearMeshData();
 
-	Normals.Init(FVector(0.0f, 0.0f, 0.0f), vertices.size());
-	Tangents.Init(FProcMeshTangent(0.0f, 0.0f, 0.0f), vertices.size());
 	VertexColors.Init(FLinearColor(0.0f, 0.0f, 0.0f), vertices.size());
 
-	for(auto v : vertices)
+	const int32 num = (int32)vertices.size();
+	const int32 chunkSize = 1024;
+
+	Vertices.SetNumUninitialized(num);
+	UV.SetNumUninitialized(num);
+	Costs.Init(1, num);
+
+	// Noise is the expensive part, every vertex is independent
+	ParallelFor(FMath::DivideAndRoundUp(num, chunkSize), [&](int32 chunk)
 	{
-		float height = 0.0f;
-		int cost = 1;
+		const int32 end = FMath::Min((chunk + 1) * chunkSize, num);
 
-		if(GenerateHeights)
+		for (int32 i = chunk * chunkSize; i < end; ++i)
 		{
-			height = GetHeight(v.normal);
-			v.position += v.normal * height;
+			const VertexPositionNormalTexture& v = vertices[i];
+
+			Vertices[i] = GenerateHeights ? v.position + v.normal * GetHeight(v.normal) : v.position;
+			UV[i] = v.uv;
 		}
+	});
 
-		Vertices.Add(v.position);
-		UV.Add(v.uv);
-		Costs.Add(cost);
-	}
+	for (const FTerrainEdit& edit : TerrainEdits)
+		ApplyEdit(edit);
 
 	for (auto i : indices)
 		Indices.Add(i);
 
+	CalculateNormals();
+
+	if (ReverseCulling)
+		ReverseWinding();
+
+	if (VertexColouring)
+		GenerateVertexColours();
+
+	TMap<FString, float> attrs;
+	attrs.Add("Tree", 100.0f);
+	attrs.Add("Mountain", 500.0f);
+
+	NodeGraph = NewObject<UNodeGraph>();
+	NodeGraph->SetAttributes(GetWorld(), Radius, NoiseHeight, attrs);
+
+	GenerateMeshSection();
+}
+
+void AGeosphere::CalculateNormals()
+{
+	Normals.Init(FVector(0.0f, 0.0f, 0.0f), Vertices.Num());
+	Tangents.Init(FProcMeshTangent(0.0f, 0.0f, 0.0f), Vertices.Num());
+
 	for (int i = 0; i < Indices.Num(); i += 3)
 	{
 		FVector p1 = Vertices[Indices[i + 0]];
@@ -350,20 +576,49 @@ void AGeosphere::Generate(float radius, size_t tessellation)
 		Tangents[Indices[i + 1]].TangentX = tangent;
 		Tangents[Indices[i + 2]].TangentX = tangent;
 	}
+}
 
-	if (ReverseCulling)
-		ReverseWinding();
+void AGeosphere::ApplyEdit(const FTerrainEdit& edit)
+{
+	if (edit.Radius <= 0.0f || edit.Height == 0.0f)
+		return;
 
-	TMap<FString, float> attrs;
-	attrs.Add("Tree", 100.0f);
-	attrs.Add("Mountain", 500.0f);
+	const FVector centre = edit.Direction.GetSafeNormal();
+	const int32 num = Vertices.Num();
+	const int32 chunkSize = 1024;
 
-	NodeGraph = NewObject<UNodeGraph>();
-	NodeGraph->SetAttributes(GetWorld(), Radius, NoiseHeight, attrs);
+	ParallelFor(FMath::DivideAndRoundUp(num, chunkSize), [&](int32 chunk)
+	{
+		const int32 end = FMath::Min((chunk + 1) * chunkSize, num);
+
+		for (int32 i = chunk * chunkSize; i < end; ++i)
+		{
+			const FVector dir = Vertices[i].GetSafeNormal();
+			const float distance = FVector::Dist(dir, centre) * Radius;
+
+			if (distance < edit.Radius)
+				Vertices[i] += dir * edit.Height * (1.0f - FMath::SmoothStep(0.0f, edit.Radius, distance));
+		}
+	});
+}
+
+void AGeosphere::ApplyTerrainEdit(FTerrainEdit edit)
+{
+	TerrainEdits.Add(edit);
+	ApplyEdit(edit);
+	CalculateNormals();
+
+	if (VertexColouring)
+		GenerateVertexColours();
 
 	GenerateMeshSection();
 }
 
+void AGeosphere::Regenerate()
+{
+	Generate(Radius, HasActorBegunPlay() ? PlayDivisions : EditorDivisions);
+}
+
 void AGeosphere::ReverseWinding()
 {
 	for (int i = 0; i < Indices.Num(); i += 3)
@@ -8,6 +8,29 @@
 #include "NodeGraph.h"
 #include "Geosphere.generated.h"
 
+/* Raises (or lowers, if Height < 0) the terrain around Direction, fading out over Radius */
+USTRUCT(BlueprintType)
+struct FTerrainEdit
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FVector Direction;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float Radius;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float Height;
+
+	FTerrainEdit() : Direction(FVector::UpVector), Radius(0.0f), Height(0.0f) {}
+
+	friend FArchive& operator<<(FArchive& ar, FTerrainEdit& e)
+	{
+		return ar << e.Direction << e.Radius << e.Height;
+	}
+};
+
 UCLASS()
 class DAWNOFCIVILISATION_API AGeosphere : public AActor
 {
@@ -59,14 +82,56 @@ class DAWNOFCIVILISATION_API AGeosphere : public AActor
 		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Rendering")
 		bool ReverseCulling;
 
+		/* Replayed in order on top of the generated heights, so a save only needs these and the seed */
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Noise")
+		TArray<FTerrainEdit> TerrainEdits;
+
+		/* Bakes biome colours into the vertex colours when the mesh is generated */
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Colouring")
+		bool VertexColouring;
+
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Colouring")
+		FLinearColor BeachColour;
+
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Colouring")
+		FLinearColor LandColour;
+
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Colouring")
+		FLinearColor MountainColour;
+
+		/* Band heights and blend width as a fraction of NoiseHeight */
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Colouring")
+		float BeachLevel;
+
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Colouring")
+		float MountainLevel;
+
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Colouring")
+		float BandBlend;
+
+		/* Slopes between these angles (degrees) fade to the mountain colour */
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Colouring")
+		float SlopeStart;
+
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Colouring")
+		float SlopeEnd;
+
+		/* Noise offset applied to HSL lightness, 0 disables it */
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Colouring")
+		float ColourJitter;
+
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Colouring")
+		float JitterFrequency;
+
 		UFUNCTION(BlueprintCallable)
 		void GetVertices(TArray<FVector>& vertices) { vertices = Vertices; }
 
 		UFUNCTION(BlueprintCallable)
 		void GetClosestVertices(TArray<int>& indices, TArray<FVector>& vertices, FVector pos, float distance);
 
+		/* The mesh no longer matches the generation key after this, so node graphs are built fresh instead of baked */
 		UFUNCTION(BlueprintCallable)
-		void SetVertex(int vertex, FVector v) { Vertices[vertex] = v; }
+		void SetVertex(int vertex, FVector v) { Vertices[vertex] = v; VerticesEdited = true; VertexGridValid = false; }
 
 		UFUNCTION(BlueprintCallable)
 		FVector GetNormal(int index) { return Normals[index]; }
@@ -74,8 +139,38 @@ class DAWNOFCIVILISATION_API AGeosphere : public AActor
 		UFUNCTION(BlueprintCallable)
 		void GenerateMeshSection();
 
+		/* Applies the edit to the mesh and records it in TerrainEdits */
+		UFUNCTION(BlueprintCallable)
+		void ApplyTerrainEdit(FTerrainEdit edit);
+
+		/* Rebuilds the mesh from the current settings at the editor or play divisions */
+		UFUNCTION(BlueprintCallable)
+		void Regenerate();
+
+		/* Fills VertexColors from the colouring settings, call GenerateMeshSection to upload them */
+		UFUNCTION(BlueprintCallable)
+		void GenerateVertexColours();
+
+		UFUNCTION(BlueprintCallable)
+		void CalculateNodeGraph(TMap<float, FNodeGraphSettings> costSettings);
+
+		/**
+		 * Poisson disc points on the terrain surface (actor space) whose height lies in
+		 * [minHeight, maxHeight] and whose slope is at most maxSlope degrees.
+		 */
 		UFUNCTION(BlueprintCallable)
-		void CalculateNodeGraph(TMap<float, FNodeGraphSettings> costSettings) { NodeGraph->Generate(Vertices, Normals, Indices, costSettings); }
+		TArray<FVector> ScatterPoints(float minDistance, float minHeight, float maxHeight, float maxSlope = 90.0f, int32 seed = 0);
+
+		/* Slope of the generated terrain (edits included) in degrees at a unit direction from the centre */
+		UFUNCTION(BlueprintCallable)
+		float GetSlope(FVector direction);
+
+		/* Height above Radius of the generated terrain at a unit direction from the centre */
+		UFUNCTION(BlueprintCallable)
+		float GetSurfaceHeight(FVector direction);
+
+		/* Hash of every input that affects the generated mesh */
+		uint32 GetGenerationKey() const;
 
 		UPROPERTY(BlueprintReadOnly)
 		UNodeGraph* NodeGraph;
@@ -90,8 +185,22 @@ class DAWNOFCIVILISATION_API AGeosphere : public AActor
 		};
 
 		void Generate(float diameter, size_t tessellation);
+
+		int32 GeneratedDivisions;
+
+		/* Set by SetVertex until the next Generate */
+		bool VerticesEdited;
+
+		/* Unit direction of every vertex, built on first lookup after the mesh changes */
+		FSpatialHashGrid VertexGrid;
+		bool VertexGridValid;
+
+		int32 FindNearestVertex(const FVector& direction);
+
 		void ClearMeshData();
 		void ReverseWinding();
+		void CalculateNormals();
+		void ApplyEdit(const FTerrainEdit& edit);
 		float GetHeight(const FVector& pos);
 
 		UPROPERTY()
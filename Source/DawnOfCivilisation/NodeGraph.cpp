@@ -1,10 +1,86 @@
 #include "NodeGraph.h"
 #include "Geosphere.h"
-#include "Algo/Reverse.h"
+#include "PathReplanner.h"
+#include "NodeGraphStats.h"
 #include "Kismet/GameplayStatics.h"
+#include "Algo/BinarySearch.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Crc.h"
+#include "Async/ParallelFor.h"
 
-#include <set>
-#include <map>
+#include <limits>
+
+static const int32 MaxFlowFields = 32;
+static const float NeighbourRadius = 140.0f;
+static const float FootprintCellSize = 500.0f;
+static const float LineOfSightSpacing = 35.0f;
+static const float MinInfluence = 0.01f;
+
+/* Nodes searched for a blocked node's neighbours to find each other again before its component is relabelled */
+static const int32 MaxSplitSearch = 4096;
+
+static const uint32 BakedGraphMagic = 0x56414E44; // "DNAV"
+static const uint32 BakedGraphVersion = 1;
+
+/* Followed by positions, normals, base costs, adjacency offsets and adjacency, all raw */
+struct FBakedGraphHeader
+{
+	uint32 Magic;
+	uint32 Version;
+	uint32 Key;
+	int32 NumNodes;
+	int32 NumEdges;
+	float MaxEdgeAngle;
+	uint32 Checksum;
+};
+
+FCostBandTable::FCostBandTable(const TMap<float, FNodeGraphSettings>& costSettings)
+{
+	costSettings.GenerateKeyArray(Keys);
+	Keys.Sort();
+
+	// Settings are applied in map order with the last match winning, so evaluate
+	// that rule once per region instead of once per node
+	auto evaluate = [&costSettings](double pos)
+	{
+		int32 cost = 1;
+
+		for (auto& setting : costSettings)
+		{
+			if (setting.Value.Less)
+				cost = (pos < setting.Key) ? setting.Value.Cost : cost;
+			else
+				cost = (pos > setting.Key) ? setting.Value.Cost : cost;
+		}
+
+		return cost;
+	};
+
+	for (int32 i = 0; i <= Keys.Num(); ++i)
+	{
+		double below;
+
+		if (Keys.Num() == 0)
+			below = 0.0;
+		else if (i == 0)
+			below = Keys[0] - 1.0;
+		else if (i == Keys.Num())
+			below = Keys.Last() + 1.0;
+		else
+			below = 0.5 * ((double)Keys[i - 1] + Keys[i]);
+
+		Costs.Add(evaluate(below));
+
+		if (i < Keys.Num())
+			Costs.Add(evaluate(Keys[i]));
+	}
+}
+
+int32 FCostBandTable::Lookup(float height) const
+{
+	int32 i = Algo::LowerBound(Keys, height);
+	return (i < Keys.Num() && Keys[i] == height) ? Costs[2 * i + 1] : Costs[2 * i];
+}
 
 void UNodeGraph::SetAttributes(UWorld* world, float radius, float height, TMap<FString, float> attrs)
 {
@@ -16,9 +92,16 @@ void UNodeGraph::SetAttributes(UWorld* world, float radius, float height, TMap<F
 
 void UNodeGraph::Generate(TArray<FVector> vertices, TArray<FVector> normals, TArray<int32> indices, TMap<float, FNodeGraphSettings> costSettings)
 {
+	SCOPE_CYCLE_COUNTER(STAT_NodeGraphGenerate);
+	double begin = FPlatformTime::Seconds();
+
 	Vertices = vertices;
-	
-	UGameplayStatics::GetAllActorsWithTag(World, "PlanetObstacle", Obstacles);
+	Nodes.Reset();
+
+	FCostBandTable bands(costSettings);
+
+	BaseCosts.SetNum(vertices.Num());
+	NodeGrid.Reset(NeighbourRadius);
 
 	for (int i = 0; i < vertices.Num(); ++i)
 	{
@@ -26,34 +109,21 @@ void UNodeGraph::Generate(TArray<FVector> vertices, TArray<FVector> normals, TAr
 		node->Id = i;
 		node->Position = vertices[i];
 		node->Normal = normals[i];
-		node->Cost = 1;
-
-		for(auto setting : costSettings)
-		{
-			float pos = (node->Position.Size() - Radius) / Height;
-
-			if (!IsObstacleInRadius(node->Position))
-			{
-				if (setting.Value.Less)
-					node->Cost = (pos < setting.Key) ? setting.Value.Cost : node->Cost;
-				else
-					node->Cost = (pos > setting.Key) ? setting.Value.Cost : node->Cost;
-			}
-			else
-				node->Cost = 0;
-		}
+		node->Cost = bands.Lookup((node->Position.Size() - Radius) / Height);
 
+		BaseCosts[i] = node->Cost;
 		Nodes.Add(node);
+		NodeGrid.Add(i, node->Position);
 	}
 
 	for (int i = 0; i < Nodes.Num(); ++i)
 	{
-		TArray<int32> ind;
-		FOccluderVertexArray vert;
-		GetClosestVertices(ind, vert, Nodes[i]->Position, 140.0f);
+		UGraphNode* node = Nodes[i];
 
-		for (auto index : ind)
-			Nodes[i]->Children.Add(Nodes[index]);
+		NodeGrid.ForEachInRadius(node->Position, NeighbourRadius, [this, node](int32 index, const FVector&)
+		{
+			node->Children.Add(Nodes[index]);
+		});
 	}
 
 	for (int i = 0; i < indices.Num(); i += 3)
@@ -68,71 +138,362 @@ void UNodeGraph::Generate(TArray<FVector> vertices, TArray<FVector> normals, TAr
 			node->Children.Add(Nodes[i2]);
 		}
 	}
+
+	BuildTopology();
+	ApplyObstacles();
+	LabelComponents();
+	ResetInfluence();
+
+	FNodeGraphProfiler::RecordBuild(TEXT("generated"), Nodes.Num(), FPlatformTime::Seconds() - begin);
 }
 
-bool UNodeGraph::Pathfind(int start, int end, TArray<UGraphNode*>& path)
+void UNodeGraph::ApplyObstacles()
 {
-	std::set<int> closed, open = { start };
+	UGameplayStatics::GetAllActorsWithTag(World, "PlanetObstacle", Obstacles);
+
+	ObstacleCoverage.Init(0, Nodes.Num());
+	Footprints.Reset();
+	FootprintGrid.Reset(FootprintCellSize);
+	MaxFootprintRadius = 0.0f;
 
-	std::map<int, int> data;
-	std::map<int, int> gScore;
-	std::map<int, int> fScore;
+	TMap<UClass*, float> classRadii;
+	TArray<int32> covered;
 
-	for(int i = 0; i < Nodes.Num(); ++i)
+	for (int i = 0; i < Obstacles.Num();)
 	{
-		gScore[i] = std::numeric_limits<int>::max();
-		fScore[i] = std::numeric_limits<int>::max();
+		FObstacleFootprint footprint;
+
+		if (!ResolveFootprint(Obstacles[i], -1.0f, footprint, &classRadii))
+		{
+			Obstacles.RemoveAtSwap(i);
+			continue;
+		}
+
+		Footprints.Add(footprint);
+		FootprintGrid.Add(i, footprint.Position);
+		MaxFootprintRadius = FMath::Max(MaxFootprintRadius, footprint.Radius);
+
+		RasteriseFootprint(footprint, 1, covered);
+		++i;
 	}
 
-	gScore[start] = 0;
-	fScore[start] = Heuristic(start, end);
+	for (int i = 0; i < Nodes.Num(); ++i)
+		Nodes[i]->Cost = ObstacleCoverage[i] > 0 ? 0 : BaseCosts[i];
+}
 
-	while(!open.empty())
+uint32 UNodeGraph::HashCostSettings(const TMap<float, FNodeGraphSettings>& costSettings)
+{
+	uint32 hash = 0;
+
+	for (auto& setting : costSettings)
 	{
-		int current, minScore = std::numeric_limits<int>::max();
+		hash = HashCombine(hash, GetTypeHash(setting.Key));
+		hash = HashCombine(hash, GetTypeHash(setting.Value.Cost));
+		hash = HashCombine(hash, (uint32)setting.Value.Less);
+	}
 
-		for (auto n : open)
-			if (fScore[n] < minScore)
-				minScore = fScore[n], current = n;
+	return hash;
+}
 
-		if(current == end)
-		{
-			int n = end;
-			path.Add(Nodes[current]);
+bool UNodeGraph::SaveBaked(const FString& path, uint32 key)
+{
+	if (!Topology.IsValid())
+		return false;
 
-			while (data.find(n) != data.end())
-			{
-				n = data[n];
-				path.Add(Nodes[n]);
-			}
+	const int32 num = Nodes.Num();
 
-			Algo::Reverse(path);
+	FBakedGraphHeader header;
+	header.Magic = BakedGraphMagic;
+	header.Version = BakedGraphVersion;
+	header.Key = key;
+	header.NumNodes = num;
+	header.NumEdges = Topology->Adjacency.Num();
+	header.MaxEdgeAngle = Topology->MaxEdgeAngle;
 
-			return true;
-		}
+	TArray<uint8> bytes;
+	bytes.Reserve(sizeof(header) + num * (2 * sizeof(FVector) + 2 * sizeof(int32)) + (header.NumEdges + 1) * sizeof(int32));
+	bytes.AddUninitialized(sizeof(header));
+
+	auto append = [&bytes](const void* data, int32 size) { bytes.Append((const uint8*)data, size); };
+
+	append(Topology->Positions.GetData(), num * sizeof(FVector));
+	append(Topology->Normals.GetData(), num * sizeof(FVector));
+	append(BaseCosts.GetData(), num * sizeof(int32));
+	append(Topology->AdjacencyOffsets.GetData(), (num + 1) * sizeof(int32));
+	append(Topology->Adjacency.GetData(), header.NumEdges * sizeof(int32));
+
+	header.Checksum = FCrc::MemCrc32(bytes.GetData() + sizeof(header), bytes.Num() - sizeof(header));
+	FMemory::Memcpy(bytes.GetData(), &header, sizeof(header));
+
+	return FFileHelper::SaveArrayToFile(bytes, *path);
+}
+
+bool UNodeGraph::LoadBaked(const FString& path, uint32 key)
+{
+	SCOPE_CYCLE_COUNTER(STAT_NodeGraphLoadBaked);
+	double begin = FPlatformTime::Seconds();
+
+	TArray<uint8> bytes;
+
+	if (!FFileHelper::LoadFileToArray(bytes, *path, FILEREAD_Silent) || bytes.Num() < (int32)sizeof(FBakedGraphHeader))
+		return false;
+
+	FBakedGraphHeader header;
+	FMemory::Memcpy(&header, bytes.GetData(), sizeof(header));
+
+	if (header.Magic != BakedGraphMagic || header.Version != BakedGraphVersion || header.Key != key)
+		return false;
+
+	const int32 num = header.NumNodes;
+	const int64 expected = sizeof(header) + (int64)num * (2 * sizeof(FVector) + 2 * sizeof(int32)) + ((int64)header.NumEdges + 1) * sizeof(int32);
 
-		open.erase(current);
-		closed.insert(current);
+	if (num < 0 || header.NumEdges < 0 || bytes.Num() != expected)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Baked node graph '%s' has the wrong size, regenerating"), *path);
+		return false;
+	}
+
+	if (FCrc::MemCrc32(bytes.GetData() + sizeof(header), bytes.Num() - sizeof(header)) != header.Checksum)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Baked node graph '%s' failed its checksum, regenerating"), *path);
+		return false;
+	}
+
+	const uint8* cursor = bytes.GetData() + sizeof(header);
+
+	auto read = [&cursor](auto& arr, int32 count)
+	{
+		arr.SetNumUninitialized(count);
+		FMemory::Memcpy(arr.GetData(), cursor, count * arr.GetTypeSize());
+		cursor += count * arr.GetTypeSize();
+	};
+
+	FNodeGraphTopology* topology = new FNodeGraphTopology();
+	topology->MaxEdgeAngle = header.MaxEdgeAngle;
+
+	read(topology->Positions, num);
+	read(topology->Normals, num);
+	read(BaseCosts, num);
+	read(topology->AdjacencyOffsets, num + 1);
+	read(topology->Adjacency, header.NumEdges);
+
+	topology->Directions.Reserve(num);
 
-		for(auto node : Nodes[current]->Children)
+	for (auto& pos : topology->Positions)
+		topology->Directions.Add(pos.GetSafeNormal());
+
+	Vertices = topology->Positions;
+	Nodes.Reset(num);
+	NodeGrid.Reset(NeighbourRadius);
+
+	for (int i = 0; i < num; ++i)
+	{
+		UGraphNode* node = NewObject<UGraphNode>();
+		node->Id = i;
+		node->Position = topology->Positions[i];
+		node->Normal = topology->Normals[i];
+
+		Nodes.Add(node);
+		NodeGrid.Add(i, node->Position);
+	}
+
+	for (int i = 0; i < num; ++i)
+	{
+		for (int32 child : topology->GetNeighbours(i))
+			Nodes[i]->Children.Add(Nodes[child]);
+	}
+
+	Topology = MakeShareable(topology);
+	Snapshot.Reset();
+	++CostVersion;
+
+	ApplyObstacles();
+	LabelComponents();
+	ResetInfluence();
+
+	FNodeGraphProfiler::RecordBuild(TEXT("loaded"), num, FPlatformTime::Seconds() - begin);
+
+	return true;
+}
+
+void UNodeGraph::BuildTopology()
+{
+	FNodeGraphTopology* topology = new FNodeGraphTopology();
+	topology->Positions.Reserve(Nodes.Num());
+	topology->Normals.Reserve(Nodes.Num());
+	topology->Directions.Reserve(Nodes.Num());
+	topology->AdjacencyOffsets.Reserve(Nodes.Num() + 1);
+
+	for (auto node : Nodes)
+	{
+		topology->Positions.Add(node->Position);
+		topology->Normals.Add(node->Normal);
+		topology->Directions.Add(node->Position.GetSafeNormal());
+	}
+
+	for (auto node : Nodes)
+	{
+		topology->AdjacencyOffsets.Add(topology->Adjacency.Num());
+
+		for (auto child : node->Children)
 		{
-			if (node->Cost <= 0 || closed.find(node->Id) != closed.end())
+			if (child == node)
 				continue;
 
-			int nScore = gScore[current] + Nodes[current]->Cost;
+			topology->Adjacency.Add(child->Id);
 
-			if (open.find(node->Id) == open.end())
-				open.insert(node->Id);
-			else if (nScore >= gScore[node->Id])
-				continue;
+			float dot = FVector::DotProduct(topology->Directions[node->Id], topology->Directions[child->Id]);
+			topology->MaxEdgeAngle = FMath::Max(topology->MaxEdgeAngle, acosf(FMath::Clamp(dot, -1.0f, 1.0f)));
+		}
+	}
+
+	topology->AdjacencyOffsets.Add(topology->Adjacency.Num());
+
+	Topology = MakeShareable(topology);
+	Snapshot.Reset();
+	++CostVersion;
+}
 
-			data[node->Id] = current;
-			gScore[node->Id] = nScore;
-			fScore[node->Id] = nScore + Heuristic(node->Id, end);
+FNodeGraphSnapshotPtr UNodeGraph::GetSnapshot()
+{
+	if (!Topology.IsValid())
+		return nullptr;
+
+	if (!Snapshot.IsValid() || Snapshot->Version != CostVersion)
+	{
+		FNodeGraphSnapshot* snapshot = new FNodeGraphSnapshot();
+		snapshot->Topology = Topology;
+		snapshot->Version = CostVersion;
+		snapshot->MinCost = std::numeric_limits<int32>::max();
+		snapshot->Costs.Reserve(Nodes.Num());
+		snapshot->Components = ComponentLabels;
+
+		for (auto node : Nodes)
+		{
+			snapshot->Costs.Add(node->Cost);
+
+			if (node->Cost > 0)
+				snapshot->MinCost = FMath::Min(snapshot->MinCost, node->Cost);
 		}
+
+		if (snapshot->MinCost == std::numeric_limits<int32>::max())
+			snapshot->MinCost = 1;
+
+		Snapshot = MakeShareable(snapshot);
 	}
 
-	return false;
+	return Snapshot;
+}
+
+bool UNodeGraph::Pathfind(int start, int end, TArray<UGraphNode*>& path)
+{
+	auto snapshot = GetSnapshot();
+	TArray<int32> ids;
+
+	if (!snapshot.IsValid() || !snapshot->FindPath(start, end, ids))
+		return false;
+
+	path.Reserve(path.Num() + ids.Num());
+
+	for (auto id : ids)
+		path.Add(Nodes[id]);
+
+	return true;
+}
+
+UFlowField* UNodeGraph::GetFlowField(TArray<int> goals)
+{
+	auto snapshot = GetSnapshot();
+
+	if (!snapshot.IsValid())
+		return NULL;
+
+	goals.Sort();
+
+	for (int i = 0; i < FlowFields.Num(); ++i)
+	{
+		UFlowField* field = FlowFields[i];
+
+		if (field->HasGoals(goals))
+		{
+			if (field->GetVersion() != CostVersion)
+				field->Build(*snapshot, goals);
+
+			// Keep the most recently used fields at the back
+			FlowFields.RemoveAt(i, 1, false);
+			FlowFields.Add(field);
+
+			return field;
+		}
+	}
+
+	if (FlowFields.Num() >= MaxFlowFields)
+		FlowFields.RemoveAt(0);
+
+	UFlowField* field = NewObject<UFlowField>(this);
+	field->Build(*snapshot, goals);
+	FlowFields.Add(field);
+
+	return field;
+}
+
+int UNodeGraph::GetFlowFieldStep(TArray<int> goals, int node)
+{
+	UFlowField* field = GetFlowField(goals);
+	return field ? field->GetNextNode(node) : INDEX_NONE;
+}
+
+void UNodeGraph::BenchmarkFlowField(int numAgents, int32 seed)
+{
+	auto snapshot = GetSnapshot();
+
+	if (!snapshot.IsValid() || snapshot->Num() == 0)
+		return;
+
+	FRandomStream rand(seed);
+	TArray<int32> starts;
+	int32 goal = INDEX_NONE;
+
+	while (goal == INDEX_NONE || !snapshot->IsPassable(goal))
+		goal = rand.RandRange(0, snapshot->Num() - 1);
+
+	for (int i = 0; i < numAgents; ++i)
+		starts.Add(rand.RandRange(0, snapshot->Num() - 1));
+
+	double begin = FPlatformTime::Seconds();
+	int32 pathSteps = 0;
+	TArray<int32> path;
+
+	for (auto start : starts)
+	{
+		if (snapshot->FindPath(start, goal, path))
+			pathSteps += path.Num() - 1;
+	}
+
+	double pathfindTime = FPlatformTime::Seconds() - begin;
+
+	begin = FPlatformTime::Seconds();
+
+	TArray<int32> distance, next;
+	snapshot->ComputeDistanceField({ goal }, distance, next);
+
+	double buildTime = FPlatformTime::Seconds() - begin;
+	int32 fieldSteps = 0;
+
+	// Agents walk the whole route one O(1) lookup at a time
+	for (auto start : starts)
+	{
+		if (distance[start] == MAX_int32)
+			continue;
+
+		for (int32 n = start; next[n] != INDEX_NONE; n = next[n])
+			++fieldSteps;
+	}
+
+	double fieldTime = FPlatformTime::Seconds() - begin;
+
+	UE_LOG(LogTemp, Log, TEXT("Flow field benchmark (%d agents, %d nodes): Pathfind %.2fms (%d steps), flow field %.2fms build + walk %.2fms (%d steps)"),
+		numAgents, snapshot->Num(), pathfindTime * 1000.0, pathSteps, buildTime * 1000.0, (fieldTime - buildTime) * 1000.0, fieldSteps);
 }
 
 int UNodeGraph::Heuristic(int start, int end)
@@ -148,46 +509,663 @@ int UNodeGraph::Heuristic(int start, int end)
 
 void UNodeGraph::GetClosestVertices(TArray<int>& indices, TArray<FVector>& vertices, FVector pos, float distance)
 {
-	float d2 = distance * distance;
-
-	for (int i = 0; i < Vertices.Num(); ++i)
+	NodeGrid.ForEachInRadius(pos, distance, [&](int32 index, const FVector& vertex)
 	{
-		if (FVector::DistSquared(Vertices[i], pos) < d2)
-			vertices.Add(Vertices[i]), indices.Add(i);
-	}
+		vertices.Add(vertex), indices.Add(index);
+	});
 }
 
 void UNodeGraph::GetClosestNode(int& index, FVector& vertex, FVector pos, float threshold)
 {
-	float d2 = threshold * threshold;
+	SCOPE_CYCLE_COUNTER(STAT_NodeGraphClosestNode);
+
 	float minDist = std::numeric_limits<float>::max();
 
-	for (int i = 0; i < Vertices.Num(); ++i)
+	NodeGrid.ForEachInRadius(pos, threshold, [&](int32 i, const FVector& v)
 	{
-		float d = FVector::DistSquared(Vertices[i], pos);
+		float d = FVector::DistSquared(v, pos);
 
-		if (d < d2 && d < minDist)
+		if (d < minDist)
 		{
-			index = i, vertex = Vertices[i];
+			index = i, vertex = v;
 			minDist = d;
 		}
-	}
+	});
 }
 
 bool UNodeGraph::IsObstacleInRadius(FVector pos, float threshold)
 {
-	for(auto o : Obstacles)
+	SCOPE_CYCLE_COUNTER(STAT_NodeGraphObstacleInRadius);
+
+	bool found = false;
+
+	FootprintGrid.ForEachInRadius(pos, MaxFootprintRadius + threshold, [&](int32 i, const FVector& centre)
+	{
+		found |= FVector::Dist(centre, pos) < Footprints[i].Radius + threshold;
+	});
+
+	return found;
+}
+
+bool UNodeGraph::ResolveFootprint(AActor* obstacle, float radius, FObstacleFootprint& footprint, TMap<UClass*, float>* classRadii)
+{
+	if (!obstacle)
+		return false;
+
+	if (radius < 0.0f)
+	{
+		UClass* c = obstacle->GetClass();
+		float* cached = classRadii ? classRadii->Find(c) : NULL;
+
+		if (cached)
+			radius = *cached;
+		else
+		{
+			// Blueprint classes are named after the asset with a "_C" suffix
+			auto attr = Attributes.Find(c->GetName().LeftChop(2));
+			radius = attr ? *attr : -1.0f;
+
+			if (classRadii)
+				classRadii->Add(c, radius);
+		}
+
+		if (radius < 0.0f)
+			return false;
+	}
+
+	footprint = FObstacleFootprint(obstacle->GetActorLocation(), radius);
+	return true;
+}
+
+void UNodeGraph::RasteriseFootprint(const FObstacleFootprint& footprint, int32 delta, TArray<int32>& touched)
+{
+	SCOPE_CYCLE_COUNTER(STAT_NodeGraphRasterise);
+
+	NodeGrid.ForEachInRadius(footprint.Position, footprint.Radius, [&](int32 index, const FVector&)
+	{
+		ObstacleCoverage[index] += delta;
+		touched.Add(index);
+	});
+}
+
+bool UNodeGraph::AddObstacle(AActor* obstacle, float radius)
+{
+	FObstacleFootprint footprint;
+
+	if (Obstacles.Contains(obstacle) || !ResolveFootprint(obstacle, radius, footprint))
+		return false;
+
+	FootprintGrid.Add(Obstacles.Num(), footprint.Position);
+	MaxFootprintRadius = FMath::Max(MaxFootprintRadius, footprint.Radius);
+	Obstacles.Add(obstacle);
+	Footprints.Add(footprint);
+
+	TArray<int32> touched;
+	RasteriseFootprint(footprint, 1, touched);
+	UpdateNodeCosts(touched);
+
+	return true;
+}
+
+bool UNodeGraph::RemoveObstacle(AActor* obstacle)
+{
+	int32 index = Obstacles.Find(obstacle);
+
+	if (index == INDEX_NONE)
+		return false;
+
+	// Use the stored footprint, the actor may have moved or be mid-destruction
+	FObstacleFootprint footprint = Footprints[index];
+	int32 last = Obstacles.Num() - 1;
+
+	FootprintGrid.Remove(index, footprint.Position);
+
+	if (index != last)
 	{
-		auto name = o->GetClass()->GetName().LeftChop(2);
+		FootprintGrid.Remove(last, Footprints[last].Position);
+		FootprintGrid.Add(index, Footprints[last].Position);
+	}
 
-		if(Attributes.Find(name) != NULL)
+	Obstacles.RemoveAtSwap(index);
+	Footprints.RemoveAtSwap(index);
+
+	TArray<int32> touched;
+	RasteriseFootprint(footprint, -1, touched);
+	UpdateNodeCosts(touched);
+
+	return true;
+}
+
+void UNodeGraph::UpdateNodeCosts(const TArray<int32>& nodes)
+{
+	TArray<int32> changed, blocked, unblocked;
+
+	for (auto index : nodes)
+	{
+		int32 cost = ObstacleCoverage[index] > 0 ? 0 : BaseCosts[index];
+		int32 previous = Nodes[index]->Cost;
+
+		if (previous != cost)
 		{
-			if (FVector::Dist(o->GetActorLocation(), pos) < Attributes[name] + threshold)
-				return true;
+			Nodes[index]->Cost = cost;
+			changed.Add(index);
+
+			if (previous > 0 && cost <= 0)
+				blocked.Add(index);
+			else if (previous <= 0 && cost > 0)
+				unblocked.Add(index);
 		}
 	}
 
-	return false;
+	if (changed.Num() == 0)
+		return;
+
+	UpdateComponents(blocked, unblocked);
+
+	uint32 previousVersion = CostVersion++;
+
+	// Fields that never reach the changed nodes or their neighbours are still exact
+	for (int i = 0; i < FlowFields.Num();)
+	{
+		UFlowField* field = FlowFields[i];
+		bool affected = field->GetVersion() != previousVersion;
+
+		for (int32 j = 0; j < changed.Num() && !affected; ++j)
+		{
+			affected = field->CanReachGoal(changed[j]);
+
+			for (int32 child : Topology->GetNeighbours(changed[j]))
+				affected |= field->CanReachGoal(child);
+		}
+
+		if (affected)
+			FlowFields.RemoveAt(i);
+		else
+			field->SetVersion(CostVersion), ++i;
+	}
+
+	OnCostsChanged.Broadcast(changed);
+}
+
+int32 UNodeGraph::FloodComponent(int32 seed, int32 label, TFunctionRef<bool(int32 label)> canRelabel)
+{
+	TArray<int32> stack = { seed };
+	int32 count = 1;
+
+	ComponentLabels[seed] = label;
+
+	while (stack.Num() > 0)
+	{
+		int32 node = stack.Pop(false);
+
+		for (int32 child : Topology->GetNeighbours(node))
+		{
+			if (Nodes[child]->Cost > 0 && ComponentLabels[child] != label && canRelabel(ComponentLabels[child]))
+			{
+				ComponentLabels[child] = label;
+				stack.Add(child);
+				++count;
+			}
+		}
+	}
+
+	return count;
+}
+
+void UNodeGraph::LabelComponents()
+{
+	ComponentLabels.Init(INDEX_NONE, Nodes.Num());
+	ComponentSizes.Reset();
+	FreeComponentLabels.Reset();
+
+	for (int i = 0; i < Nodes.Num(); ++i)
+	{
+		if (Nodes[i]->Cost > 0 && ComponentLabels[i] == INDEX_NONE)
+		{
+			int32 label = ComponentSizes.Add(0);
+			ComponentSizes[label] = FloodComponent(i, label, [](int32 l) { return l == INDEX_NONE; });
+		}
+	}
+}
+
+int32 UNodeGraph::AllocateComponentLabel(int32 size)
+{
+	if (FreeComponentLabels.Num() == 0)
+		return ComponentSizes.Add(size);
+
+	int32 label = FreeComponentLabels.Pop(false);
+	ComponentSizes[label] = size;
+
+	return label;
+}
+
+void UNodeGraph::FreeComponentLabel(int32 label)
+{
+	ComponentSizes[label] = 0;
+	FreeComponentLabels.Add(label);
+}
+
+bool UNodeGraph::AreLocallyConnected(const TArray<int32>& nodes, int32 label) const
+{
+	TSet<int32> remaining(nodes);
+	TSet<int32> visited = { nodes[0] };
+	TArray<int32> queue = { nodes[0] };
+
+	remaining.Remove(nodes[0]);
+
+	for (int32 head = 0; head < queue.Num() && remaining.Num() > 0; ++head)
+	{
+		// Out of budget counts as a split, the caller then relabels the whole component
+		if (visited.Num() >= MaxSplitSearch)
+			return false;
+
+		for (int32 child : Topology->GetNeighbours(queue[head]))
+		{
+			if (Nodes[child]->Cost > 0 && ComponentLabels[child] == label && !visited.Contains(child))
+			{
+				visited.Add(child);
+				queue.Add(child);
+				remaining.Remove(child);
+			}
+		}
+	}
+
+	return remaining.Num() == 0;
+}
+
+void UNodeGraph::UpdateComponents(const TArray<int32>& blocked, const TArray<int32>& unblocked)
+{
+	// Blocking a node can split its component, but only if its neighbours can't find each other around it
+	TMap<int32, TArray<int32>> boundaries;
+	TSet<int32> touched, split;
+
+	for (auto node : blocked)
+	{
+		int32 label = ComponentLabels[node];
+
+		if (label != INDEX_NONE)
+		{
+			--ComponentSizes[label];
+			touched.Add(label);
+		}
+
+		ComponentLabels[node] = INDEX_NONE;
+	}
+
+	for (auto node : blocked)
+	{
+		for (int32 child : Topology->GetNeighbours(node))
+		{
+			int32 label = ComponentLabels[child];
+
+			if (Nodes[child]->Cost > 0 && touched.Contains(label))
+				boundaries.FindOrAdd(label).AddUnique(child);
+		}
+	}
+
+	for (auto label : touched)
+	{
+		TArray<int32>* boundary = boundaries.Find(label);
+
+		// Nothing passable was left next to the blocked nodes, so they were the whole component
+		if (!boundary)
+			FreeComponentLabel(label);
+		else if (!AreLocallyConnected(*boundary, label))
+			split.Add(label);
+	}
+
+	for (auto& boundary : boundaries)
+	{
+		if (!split.Contains(boundary.Key))
+			continue;
+
+		for (int32 child : boundary.Value)
+		{
+			if (split.Contains(ComponentLabels[child]))
+			{
+				int32 fresh = AllocateComponentLabel(0);
+				ComponentSizes[fresh] = FloodComponent(child, fresh, [&split](int32 l) { return split.Contains(l); });
+			}
+		}
+	}
+
+	// Every node left in a split component now has a fresh label, so the old ones can be reused
+	for (auto label : split)
+		FreeComponentLabel(label);
+
+	// Unblocking a node joins the components around it into the largest one
+	for (auto node : unblocked)
+	{
+		int32 keep = INDEX_NONE;
+
+		for (int32 child : Topology->GetNeighbours(node))
+		{
+			int32 label = ComponentLabels[child];
+
+			if (Nodes[child]->Cost > 0 && label != INDEX_NONE && (keep == INDEX_NONE || ComponentSizes[label] > ComponentSizes[keep]))
+				keep = label;
+		}
+
+		if (keep == INDEX_NONE)
+		{
+			keep = AllocateComponentLabel(1);
+			ComponentLabels[node] = keep;
+			continue;
+		}
+
+		ComponentLabels[node] = keep;
+		++ComponentSizes[keep];
+
+		for (int32 child : Topology->GetNeighbours(node))
+		{
+			int32 label = ComponentLabels[child];
+
+			if (Nodes[child]->Cost > 0 && label != INDEX_NONE && label != keep)
+			{
+				ComponentSizes[keep] += FloodComponent(child, keep, [label](int32 l) { return l == label; });
+				FreeComponentLabel(label);
+			}
+		}
+	}
+}
+
+bool UNodeGraph::AreConnected(int a, int b)
+{
+	auto snapshot = GetSnapshot();
+	return snapshot.IsValid() && snapshot->AreConnected(a, b);
+}
+
+int UNodeGraph::FindNearestReachableNode(int start, int end)
+{
+	auto snapshot = GetSnapshot();
+	return snapshot.IsValid() ? snapshot->FindNearestReachable(start, end) : INDEX_NONE;
+}
+
+bool UNodeGraph::PathfindNearest(int start, int end, TArray<UGraphNode*>& path, bool& reachedGoal)
+{
+	auto snapshot = GetSnapshot();
+	reachedGoal = false;
+
+	if (!snapshot.IsValid())
+		return false;
+
+	int32 target = snapshot->FindNearestReachable(start, end);
+
+	if (target == INDEX_NONE || !Pathfind(start, target, path))
+		return false;
+
+	reachedGoal = target == end;
+	return true;
+}
+
+UPathReplanner* UNodeGraph::CreateReplanner(int start, int end)
+{
+	UPathReplanner* replanner = NewObject<UPathReplanner>(this);
+	replanner->Initialise(this, start, end);
+	return replanner;
+}
+
+void UNodeGraph::ResetInfluence()
+{
+	for (auto& layer : Influence)
+		layer.Init(0.0f, Nodes.Num());
+
+	// Sources survive a rebuild as long as their node still exists
+	for (auto it = InfluenceSources.CreateIterator(); it; ++it)
+	{
+		if (Topology->IsValidNode(it.Value().Node))
+			PropagateInfluence(it.Value(), 1.0f);
+		else
+			it.RemoveCurrent();
+	}
+}
+
+void UNodeGraph::PropagateInfluence(const FInfluenceSource& source, float sign)
+{
+	TArray<float>& layer = Influence[(int32)source.Layer];
+	TSet<int32> visited = { source.Node };
+	TArray<int32> frontier = { source.Node }, next;
+	float value = source.Strength * sign;
+
+	for (int32 hop = 0; hop <= source.MaxHops && frontier.Num() > 0 && FMath::Abs(value) >= MinInfluence; ++hop)
+	{
+		next.Reset();
+
+		for (int32 node : frontier)
+		{
+			layer[node] += value;
+
+			// Every contribution is at least MinInfluence, anything smaller left after a removal is rounding residue
+			if (sign < 0.0f && FMath::Abs(layer[node]) < MinInfluence * 0.5f)
+				layer[node] = 0.0f;
+
+			for (int32 child : Topology->GetNeighbours(node))
+			{
+				bool alreadyVisited = false;
+				visited.Add(child, &alreadyVisited);
+
+				if (!alreadyVisited)
+					next.Add(child);
+			}
+		}
+
+		Swap(frontier, next);
+		value *= source.Decay;
+	}
+}
+
+int UNodeGraph::AddInfluenceSource(EInfluenceLayer layer, int node, float strength, float decay, int maxHops)
+{
+	if (!Topology.IsValid() || !Topology->IsValidNode(node) || layer == EInfluenceLayer::Count)
+		return 0;
+
+	FInfluenceSource source;
+	source.Layer = layer;
+	source.Node = node;
+	source.Strength = strength;
+	source.Decay = FMath::Clamp(decay, 0.0f, 1.0f);
+	source.MaxHops = FMath::Max(maxHops, 0);
+
+	int32 handle = NextInfluenceHandle++;
+	InfluenceSources.Add(handle, source);
+	PropagateInfluence(source, 1.0f);
+
+	return handle;
+}
+
+bool UNodeGraph::RemoveInfluenceSource(int handle)
+{
+	FInfluenceSource source;
+
+	if (!InfluenceSources.RemoveAndCopyValue(handle, source))
+		return false;
+
+	// Contributions are additive, so subtracting the same walk undoes it up to float rounding
+	PropagateInfluence(source, -1.0f);
+	return true;
+}
+
+bool UNodeGraph::MoveInfluenceSource(int handle, int node)
+{
+	FInfluenceSource* source = InfluenceSources.Find(handle);
+
+	if (!source || !Topology->IsValidNode(node))
+		return false;
+
+	if (source->Node != node)
+	{
+		PropagateInfluence(*source, -1.0f);
+		source->Node = node;
+		PropagateInfluence(*source, 1.0f);
+	}
+
+	return true;
+}
+
+float UNodeGraph::GetInfluence(EInfluenceLayer layer, int node) const
+{
+	if (layer == EInfluenceLayer::Count)
+		return 0.0f;
+
+	const TArray<float>& values = Influence[(int32)layer];
+	return values.IsValidIndex(node) ? values[node] : 0.0f;
+}
+
+int UNodeGraph::FindBestNodeInRadius(EInfluenceLayer layer, FVector pos, float radius, bool highest)
+{
+	if (layer == EInfluenceLayer::Count)
+		return INDEX_NONE;
+
+	TArray<int32> candidates;
+	NodeGrid.ForEachInRadius(pos, radius, [&candidates](int32 index, const FVector&) { candidates.Add(index); });
+
+	if (candidates.Num() == 0)
+		return INDEX_NONE;
+
+	const TArray<float>& values = Influence[(int32)layer];
+	const float direction = highest ? 1.0f : -1.0f;
+
+	const int32 chunkSize = 256;
+	const int32 numChunks = FMath::DivideAndRoundUp(candidates.Num(), chunkSize);
+	TArray<int32> chunkBest;
+	chunkBest.Init(INDEX_NONE, numChunks);
+
+	ParallelFor(numChunks, [&](int32 chunk)
+	{
+		int32 best = INDEX_NONE;
+		float bestValue = -MAX_flt;
+		int32 end = FMath::Min((chunk + 1) * chunkSize, candidates.Num());
+
+		for (int32 i = chunk * chunkSize; i < end; ++i)
+		{
+			float value = values[candidates[i]] * direction;
+
+			if (value > bestValue)
+				best = candidates[i], bestValue = value;
+		}
+
+		chunkBest[chunk] = best;
+	}, numChunks == 1);
+
+	int32 best = chunkBest[0];
+
+	for (int32 candidate : chunkBest)
+	{
+		if (values[candidate] * direction > values[best] * direction)
+			best = candidate;
+	}
+
+	return best;
+}
+
+bool UNodeGraph::HasLineOfSight(int32 from, int32 to, int32 maxCost)
+{
+	FVector a = Nodes[from]->Position, b = Nodes[to]->Position;
+	float ra = a.Size(), rb = b.Size();
+	FVector da = a / ra, db = b / rb;
+
+	float angle = acosf(FMath::Clamp(FVector::DotProduct(da, db), -1.0f, 1.0f));
+	int32 steps = FMath::CeilToInt(angle * 0.5f * (ra + rb) / LineOfSightSpacing);
+
+	if (steps <= 1)
+		return true;
+
+	float sinAngle = FMath::Sin(angle);
+
+	for (int32 k = 1; k < steps; ++k)
+	{
+		float t = (float)k / steps;
+		FVector dir = (FMath::Sin((1.0f - t) * angle) * da + FMath::Sin(t * angle) * db) / sinAngle;
+		FVector sample = dir * FMath::Lerp(ra, rb, t);
+
+		int32 index = INDEX_NONE;
+		FVector vertex;
+		GetClosestNode(index, vertex, sample, NeighbourRadius);
+
+		// Don't cut through terrain the original path was routed around
+		if (index == INDEX_NONE || Nodes[index]->Cost <= 0 || Nodes[index]->Cost > maxCost)
+			return false;
+	}
+
+	return true;
+}
+
+void UNodeGraph::SmoothPathNative(const TArray<int32>& path, TArray<int32>& waypoints)
+{
+	waypoints.Reset();
+
+	if (path.Num() <= 2)
+	{
+		waypoints = path;
+		return;
+	}
+
+	int32 anchor = 0;
+	waypoints.Add(path[0]);
+
+	while (anchor < path.Num() - 1)
+	{
+		int32 end = anchor + 1;
+		int32 maxCost = FMath::Max(Nodes[path[anchor]]->Cost, Nodes[path[end]]->Cost);
+
+		while (end + 1 < path.Num())
+		{
+			int32 cost = FMath::Max(maxCost, Nodes[path[end + 1]]->Cost);
+
+			if (!HasLineOfSight(path[anchor], path[end + 1], cost))
+				break;
+
+			maxCost = cost;
+			++end;
+		}
+
+		waypoints.Add(path[end]);
+		anchor = end;
+	}
+}
+
+void UNodeGraph::SmoothPath(const TArray<UGraphNode*>& path, TArray<FVector>& waypoints)
+{
+	TArray<int32> ids, smoothed;
+	ids.Reserve(path.Num());
+
+	for (auto node : path)
+		ids.Add(node->Id);
+
+	SmoothPathNative(ids, smoothed);
+	waypoints.Reset(smoothed.Num());
+
+	for (auto id : smoothed)
+		waypoints.Add(Nodes[id]->Position);
+}
+
+FVector UNodeGraph::EvaluatePathSpline(const TArray<FVector>& waypoints, float t)
+{
+	if (waypoints.Num() == 0)
+		return FVector::ZeroVector;
+
+	if (waypoints.Num() == 1)
+		return waypoints[0];
+
+	int32 segments = waypoints.Num() - 1;
+	float scaled = FMath::Clamp(t, 0.0f, 1.0f) * segments;
+	int32 i = FMath::Min(FMath::FloorToInt(scaled), segments - 1);
+	float u = scaled - i;
+
+	FVector p0 = waypoints[FMath::Max(i - 1, 0)];
+	FVector p1 = waypoints[i];
+	FVector p2 = waypoints[i + 1];
+	FVector p3 = waypoints[FMath::Min(i + 2, segments)];
+
+	// Catmull-Rom segment expressed as a cubic Bezier
+	FVector c1 = p1 + (p2 - p0) / 6.0f;
+	FVector c2 = p2 - (p3 - p1) / 6.0f;
+
+	FVector pos(Bezier(p1.X, c1.X, c2.X, p2.X, u),
+				Bezier(p1.Y, c1.Y, c2.Y, p2.Y, u),
+				Bezier(p1.Z, c1.Z, c2.Z, p2.Z, u));
+
+	return pos.GetSafeNormal() * FMath::Lerp(p1.Size(), p2.Size(), u);
 }
 
 float UNodeGraph::Bezier(float p1, float p2, float p3, float p4, float t)
@@ -3,6 +3,9 @@
 #include "CoreMinimal.h"
 #include "UObject/NoExportTypes.h"
 #include "GraphNode.h"
+#include "NodeGraphSnapshot.h"
+#include "FlowField.h"
+#include "SpatialHashGrid.h"
 #include "NodeGraph.generated.h"
 
 USTRUCT(BlueprintType)
@@ -17,13 +20,56 @@ struct FNodeGraphSettings
 	bool Less;
 };
 
+UENUM(BlueprintType)
+enum class EInfluenceLayer : uint8
+{
+	Threat		 UMETA(DisplayName = "Threat"),
+	Resources	 UMETA(DisplayName = "Resources"),
+	Buildings	 UMETA(DisplayName = "Buildings"),
+	Count		 UMETA(Hidden)
+};
+
+struct FInfluenceSource
+{
+	EInfluenceLayer Layer;
+	int32 Node;
+	float Strength;
+	float Decay;
+	int32 MaxHops;
+};
+
+struct FObstacleFootprint
+{
+	FVector Position;
+	float Radius;
+
+	FObstacleFootprint() : Position(FVector::ZeroVector), Radius(0.0f) {}
+	FObstacleFootprint(FVector pos, float radius) : Position(pos), Radius(radius) {}
+};
+
+/**
+ * costSettings flattened into sorted thresholds. Region 2i is the open interval
+ * below Keys[i] (above the previous key), region 2i + 1 is exactly Keys[i].
+ */
+struct FCostBandTable
+{
+	TArray<float> Keys;
+	TArray<int32> Costs;
+
+	FCostBandTable(const TMap<float, FNodeGraphSettings>& costSettings);
+
+	int32 Lookup(float height) const;
+};
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnNodeCostsChanged, const TArray<int32>& /* nodes */);
+
 UCLASS(BlueprintType)
 class DAWNOFCIVILISATION_API UNodeGraph : public UObject
 {
 	GENERATED_BODY()
 	
 	public:
-		UNodeGraph() {}
+		UNodeGraph() : MaxFootprintRadius(0.0f), NextInfluenceHandle(1), CostVersion(0) {}
 
 		void SetAttributes(UWorld* world, float radius, float height, TMap<FString, float> attrs);
 		void Generate(TArray<FVector> vertices, TArray<FVector> normals, TArray<int32> indices, TMap<float, FNodeGraphSettings> costSettings);
@@ -41,6 +87,85 @@ class DAWNOFCIVILISATION_API UNodeGraph : public UObject
 		UFUNCTION(BlueprintCallable)
 		UGraphNode* GetNodeByIndex(int index) { return index < Nodes.Num() ? Nodes[index] : NULL; }
 
+		/* 0 until Generate or LoadBaked has run */
+		UFUNCTION(BlueprintCallable)
+		int GetNumNodes() const { return Nodes.Num(); }
+
+		/* Adds strength * decay^hops to every node within maxHops of node, returns a handle */
+		UFUNCTION(BlueprintCallable)
+		int AddInfluenceSource(EInfluenceLayer layer, int node, float strength, float decay = 0.5f, int maxHops = 8);
+
+		UFUNCTION(BlueprintCallable)
+		bool RemoveInfluenceSource(int handle);
+
+		UFUNCTION(BlueprintCallable)
+		bool MoveInfluenceSource(int handle, int node);
+
+		UFUNCTION(BlueprintCallable)
+		float GetInfluence(EInfluenceLayer layer, int node) const;
+
+		/* Node within radius of pos with the highest (or lowest) value on the layer, -1 if none */
+		UFUNCTION(BlueprintCallable)
+		int FindBestNodeInRadius(EInfluenceLayer layer, FVector pos, float radius, bool highest = true);
+
+		/* Drops every waypoint the agent can skip by following the great-circle arc past it */
+		UFUNCTION(BlueprintCallable)
+		void SmoothPath(const TArray<UGraphNode*>& path, TArray<FVector>& waypoints);
+
+		void SmoothPathNative(const TArray<int32>& path, TArray<int32>& waypoints);
+
+		/* Position at t in [0, 1] along a Catmull-Rom spline through the waypoints, kept on the surface */
+		UFUNCTION(BlueprintCallable)
+		FVector EvaluatePathSpline(const TArray<FVector>& waypoints, float t);
+
+		/* Compact binary copy of the graph layout and height costs, obstacles are re-applied on load */
+		bool SaveBaked(const FString& path, uint32 key);
+		bool LoadBaked(const FString& path, uint32 key);
+		static uint32 HashCostSettings(const TMap<float, FNodeGraphSettings>& costSettings);
+
+		/* O(1) reachability check from connected components kept up to date as costs change */
+		UFUNCTION(BlueprintCallable)
+		bool AreConnected(int a, int b);
+
+		/* Falls back to the closest node to end that is reachable from start when end itself isn't */
+		UFUNCTION(BlueprintCallable)
+		bool PathfindNearest(int start, int end, TArray<UGraphNode*>& path, bool& reachedGoal);
+
+		UFUNCTION(BlueprintCallable)
+		int FindNearestReachableNode(int start, int end);
+
+		/* Marks the nodes under the obstacle as impassable, radius < 0 uses the class attribute */
+		UFUNCTION(BlueprintCallable)
+		bool AddObstacle(AActor* obstacle, float radius = -1.0f);
+
+		UFUNCTION(BlueprintCallable)
+		bool RemoveObstacle(AActor* obstacle);
+
+		UFUNCTION(BlueprintCallable)
+		bool IsObstacleInRadius(FVector pos, float threshold = 0.0f);
+
+		/* Incremental replanner for an agent already following a path */
+		UFUNCTION(BlueprintCallable)
+		class UPathReplanner* CreateReplanner(int start, int end);
+
+		/* Shared distance field towards the goals, cached until costs change */
+		UFUNCTION(BlueprintCallable)
+		UFlowField* GetFlowField(TArray<int> goals);
+
+		UFUNCTION(BlueprintCallable)
+		int GetFlowFieldStep(TArray<int> goals, int node);
+
+		/* Logs flow field vs individual Pathfind timings for numAgents random starts heading to one goal */
+		UFUNCTION(BlueprintCallable)
+		void BenchmarkFlowField(int numAgents = 500, int32 seed = 0);
+
+		/* Thread-safe view of the current costs, rebuilt lazily after they change */
+		FNodeGraphSnapshotPtr GetSnapshot();
+		uint32 GetCostVersion() const { return CostVersion; }
+
+		/* Broadcast with the ids of every node whose cost changed after generation */
+		FOnNodeCostsChanged OnCostsChanged;
+
 	private:
 		UPROPERTY()
 		TArray<UGraphNode*> Nodes;
@@ -63,6 +188,47 @@ class DAWNOFCIVILISATION_API UNodeGraph : public UObject
 		UPROPERTY()
 		TArray<AActor*> Obstacles;
 
-		bool IsObstacleInRadius(FVector pos, float threshold = 0.0f);
+		UPROPERTY()
+		TArray<UFlowField*> FlowFields;
+
+		/* Footprint of each entry in Obstacles at the time it was added, bucketed by index */
+		TArray<FObstacleFootprint> Footprints;
+		FSpatialHashGrid FootprintGrid;
+		float MaxFootprintRadius;
+
+		FSpatialHashGrid NodeGrid;
+
+		/* One value per node per layer, the sum of every source's decayed contribution */
+		TArray<float> Influence[(int32)EInfluenceLayer::Count];
+		TMap<int32, FInfluenceSource> InfluenceSources;
+		int32 NextInfluenceHandle;
+
+		/* Component label per passable node, and node count per label; emptied labels are reused */
+		TArray<int32> ComponentLabels;
+		TArray<int32> ComponentSizes;
+		TArray<int32> FreeComponentLabels;
+
+		/* Height band cost, and how many footprints cover each node */
+		TArray<int32> BaseCosts;
+		TArray<int32> ObstacleCoverage;
+
+		FNodeGraphTopologyPtr Topology;
+		FNodeGraphSnapshotPtr Snapshot;
+		uint32 CostVersion;
+
+		void BuildTopology();
+		bool ResolveFootprint(AActor* obstacle, float radius, FObstacleFootprint& footprint, TMap<UClass*, float>* classRadii = nullptr);
+		void RasteriseFootprint(const FObstacleFootprint& footprint, int32 delta, TArray<int32>& touched);
+		void ApplyObstacles();
+		void ResetInfluence();
+		void PropagateInfluence(const FInfluenceSource& source, float sign);
+		void UpdateNodeCosts(const TArray<int32>& nodes);
+		void LabelComponents();
+		void UpdateComponents(const TArray<int32>& blocked, const TArray<int32>& unblocked);
+		bool AreLocallyConnected(const TArray<int32>& nodes, int32 label) const;
+		int32 AllocateComponentLabel(int32 size);
+		void FreeComponentLabel(int32 label);
+		int32 FloodComponent(int32 seed, int32 label, TFunctionRef<bool(int32 label)> canRelabel);
+		bool HasLineOfSight(int32 from, int32 to, int32 maxCost);
 		float Bezier(float p1, float p2, float p3, float p4, float t);
 };
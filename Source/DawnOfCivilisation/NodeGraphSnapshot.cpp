@@ -0,0 +1,285 @@
+#include "NodeGraphSnapshot.h"
+#include "NodeGraphStats.h"
+#include "Algo/Reverse.h"
+
+#include <limits>
+
+namespace
+{
+	struct FOpenEntry
+	{
+		float Score;
+		int32 Node;
+
+		FOpenEntry(float score, int32 node) : Score(score), Node(node) {}
+	};
+
+	struct FOpenEntryPredicate
+	{
+		bool operator()(const FOpenEntry& a, const FOpenEntry& b) const { return a.Score < b.Score; }
+	};
+}
+
+bool FNodeGraphSnapshot::FindPath(int32 start, int32 end, TArray<int32>& path, FPathQueryStats* stats) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_NodeGraphPathfind);
+	INC_DWORD_STAT(STAT_NodeGraphQueries);
+
+	FPathQueryStats local;
+	FPathQueryStats& query = stats ? *stats : local;
+	double begin = FPlatformTime::Seconds();
+
+	query.Start = start;
+	query.End = end;
+
+	query.Success = FindPathInternal(start, end, path, query);
+	query.PathLength = path.Num();
+	query.Seconds = FPlatformTime::Seconds() - begin;
+
+	INC_DWORD_STAT_BY(STAT_NodeGraphExpanded, query.Expanded);
+
+#if STATS
+	FNodeGraphProfiler::RecordQuery(query);
+#endif
+
+	return query.Success;
+}
+
+bool FNodeGraphSnapshot::FindPathInternal(int32 start, int32 end, TArray<int32>& path, FPathQueryStats& stats) const
+{
+	path.Reset();
+
+	if (!Topology.IsValid() || !Topology->IsValidNode(start) || !Topology->IsValidNode(end))
+		return false;
+
+	if (start == end)
+	{
+		path.Add(start);
+		return true;
+	}
+
+	if (!AreConnected(start, end))
+		return false;
+
+	const int32 num = Num();
+
+	TArray<int32> gScore, parent;
+	TBitArray<> closed(false, num);
+
+	gScore.Init(std::numeric_limits<int32>::max(), num);
+	parent.Init(INDEX_NONE, num);
+
+	TArray<FOpenEntry> open;
+	open.HeapPush(FOpenEntry(Heuristic(start, end), start), FOpenEntryPredicate());
+	gScore[start] = 0;
+
+	while (open.Num() > 0)
+	{
+		FOpenEntry entry(0.0f, INDEX_NONE);
+		open.HeapPop(entry, FOpenEntryPredicate(), false);
+
+		int32 current = entry.Node;
+
+		// Stale duplicates are left in the heap rather than decreased in place
+		if (closed[current])
+			continue;
+
+		if (current == end)
+		{
+			for (int32 n = end; n != INDEX_NONE; n = parent[n])
+				path.Add(n);
+
+			Algo::Reverse(path);
+			return true;
+		}
+
+		closed[current] = true;
+		++stats.Expanded;
+
+		int32 nScore = gScore[current] + Costs[current];
+
+		for (int32 child : Topology->GetNeighbours(current))
+		{
+			if (!IsPassable(child) || closed[child] || nScore >= gScore[child])
+				continue;
+
+			parent[child] = current;
+			gScore[child] = nScore;
+			open.HeapPush(FOpenEntry(nScore + Heuristic(child, end), child), FOpenEntryPredicate());
+		}
+
+		stats.OpenPeak = FMath::Max(stats.OpenPeak, open.Num());
+	}
+
+	return false;
+}
+
+bool FNodeGraphSnapshot::AreConnected(int32 start, int32 end) const
+{
+	if (!Topology->IsValidNode(start) || !Topology->IsValidNode(end))
+		return false;
+
+	if (start == end)
+		return true;
+
+	if (!IsPassable(end))
+		return false;
+
+	if (IsPassable(start))
+		return Components[start] == Components[end];
+
+	// An agent standing on an impassable node can still step off it
+	for (int32 child : Topology->GetNeighbours(start))
+	{
+		if (IsPassable(child) && Components[child] == Components[end])
+			return true;
+	}
+
+	return false;
+}
+
+int32 FNodeGraphSnapshot::FindNearestReachable(int32 start, int32 goal) const
+{
+	if (!Topology->IsValidNode(start) || !Topology->IsValidNode(goal))
+		return INDEX_NONE;
+
+	TBitArray<> visited(false, Num());
+	TArray<int32> layer = { goal }, nextLayer;
+	visited[goal] = true;
+
+	while (layer.Num() > 0)
+	{
+		int32 best = INDEX_NONE;
+		float bestDist = MAX_flt;
+
+		for (int32 node : layer)
+		{
+			if (!AreConnected(start, node))
+				continue;
+
+			float d = FVector::DistSquared(Topology->Positions[node], Topology->Positions[goal]);
+
+			if (d < bestDist)
+				best = node, bestDist = d;
+		}
+
+		if (best != INDEX_NONE)
+			return best;
+
+		nextLayer.Reset();
+
+		for (int32 node : layer)
+		{
+			for (int32 child : Topology->GetNeighbours(node))
+			{
+				if (!visited[child])
+				{
+					visited[child] = true;
+					nextLayer.Add(child);
+				}
+			}
+		}
+
+		Swap(layer, nextLayer);
+	}
+
+	return INDEX_NONE;
+}
+
+void FNodeGraphSnapshot::ComputeDistanceField(const TArray<int32>& goals, TArray<int32>& distance, TArray<int32>& next, const TArray<int32>* targets) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_NodeGraphDistanceField);
+
+	const int32 num = Num();
+
+	distance.Init(MAX_int32, num);
+	next.Init(INDEX_NONE, num);
+
+	TArray<FOpenEntry> open;
+
+	for (int32 goal : goals)
+	{
+		if (Topology->IsValidNode(goal) && IsPassable(goal) && distance[goal] != 0)
+		{
+			distance[goal] = 0;
+			open.HeapPush(FOpenEntry(0.0f, goal), FOpenEntryPredicate());
+		}
+	}
+
+	// Targets no goal can reach would never be found, so they don't hold the search open
+	TArray<int32> pending;
+	TBitArray<> isPending(false, targets ? num : 0);
+	int32 unreached = 0;
+
+	if (targets)
+	{
+		for (int32 target : *targets)
+		{
+			if (!Topology->IsValidNode(target) || isPending[target] || !goals.ContainsByPredicate([&](int32 goal) { return AreConnected(target, goal); }))
+				continue;
+
+			isPending[target] = true;
+			pending.Add(target);
+
+			if (distance[target] == MAX_int32)
+				++unreached;
+		}
+
+		if (pending.Num() == 0)
+			return;
+	}
+
+	// Once every target has been reached their largest distance only shrinks, and nothing popped at or past it can lower one
+	int32 bound = targets && unreached == 0 ? 0 : MAX_int32;
+
+	while (open.Num() > 0)
+	{
+		FOpenEntry entry(0.0f, INDEX_NONE);
+		open.HeapPop(entry, FOpenEntryPredicate(), false);
+
+		int32 current = entry.Node;
+
+		if (entry.Score > distance[current])
+			continue;
+
+		if (distance[current] >= bound)
+			break;
+
+		for (int32 child : Topology->GetNeighbours(current))
+		{
+			// Stepping child -> current costs the child's cost, as in FindPath
+			int32 nScore = distance[current] + FMath::Max(Costs[child], 0);
+
+			if (nScore >= distance[child])
+				continue;
+
+			bool firstReached = targets && isPending[child] && distance[child] == MAX_int32;
+
+			distance[child] = nScore;
+			next[child] = current;
+
+			if (firstReached && --unreached == 0)
+			{
+				bound = 0;
+
+				for (int32 target : pending)
+					bound = FMath::Max(bound, distance[target]);
+			}
+
+			// Impassable nodes can be left (an agent standing on one) but never passed through
+			if (IsPassable(child))
+				open.HeapPush(FOpenEntry((float)nScore, child), FOpenEntryPredicate());
+		}
+	}
+}
+
+float FNodeGraphSnapshot::Heuristic(int32 start, int32 end) const
+{
+	if (Topology->MaxEdgeAngle <= 0.0f)
+		return 0.0f;
+
+	float dot = FMath::Clamp(FVector::DotProduct(Topology->Directions[start], Topology->Directions[end]), -1.0f, 1.0f);
+
+	// Every hop costs at least MinCost and covers at most MaxEdgeAngle radians
+	return acosf(dot) / Topology->MaxEdgeAngle * MinCost;
+}
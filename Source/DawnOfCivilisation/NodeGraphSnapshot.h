@@ -0,0 +1,88 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Static layout of a node graph (positions and adjacency). Built once per
+ * UNodeGraph::Generate and shared by every snapshot taken from that graph.
+ */
+struct DAWNOFCIVILISATION_API FNodeGraphTopology
+{
+	TArray<FVector> Positions;
+	TArray<FVector> Normals;
+
+	/** Normalised positions, used for great-circle distances */
+	TArray<FVector> Directions;
+
+	/** CSR adjacency: neighbours of node i are Adjacency[AdjacencyOffsets[i] .. AdjacencyOffsets[i + 1]) */
+	TArray<int32> AdjacencyOffsets;
+	TArray<int32> Adjacency;
+
+	/** Largest angle (radians) spanned by a single edge, used to keep the A* heuristic admissible */
+	float MaxEdgeAngle;
+
+	FNodeGraphTopology() : MaxEdgeAngle(0.0f) {}
+
+	int32 Num() const { return Positions.Num(); }
+	bool IsValidNode(int32 node) const { return node >= 0 && node < Positions.Num(); }
+
+	TArrayView<const int32> GetNeighbours(int32 node) const
+	{
+		int32 first = AdjacencyOffsets[node];
+		return TArrayView<const int32>(Adjacency.GetData() + first, AdjacencyOffsets[node + 1] - first);
+	}
+};
+
+typedef TSharedPtr<const FNodeGraphTopology, ESPMode::ThreadSafe> FNodeGraphTopologyPtr;
+
+/**
+ * Immutable copy of the graph costs at a point in time. Safe to read from any
+ * thread; UNodeGraph hands out a new one whenever its costs change.
+ */
+struct DAWNOFCIVILISATION_API FNodeGraphSnapshot
+{
+	FNodeGraphTopologyPtr Topology;
+
+	/** Per node traversal cost, <= 0 is impassable */
+	TArray<int32> Costs;
+
+	/** Matches UNodeGraph::GetCostVersion at the time the snapshot was taken */
+	uint32 Version;
+
+	/** Connected component of each passable node, INDEX_NONE for impassable ones */
+	TArray<int32> Components;
+
+	/** Cheapest passable node cost, used to scale the heuristic */
+	int32 MinCost;
+
+	FNodeGraphSnapshot() : Version(0), MinCost(1) {}
+
+	int32 Num() const { return Costs.Num(); }
+	bool IsPassable(int32 node) const { return Costs[node] > 0; }
+
+	/** True if a path from start to end exists; start itself may be impassable */
+	bool AreConnected(int32 start, int32 end) const;
+
+	/** Passable node reachable from start with the fewest hops to goal, ties broken by distance */
+	int32 FindNearestReachable(int32 start, int32 goal) const;
+
+	/** Same semantics as UNodeGraph::Pathfind: leaving a node costs its Cost, impassable nodes can't be entered */
+	bool FindPath(int32 start, int32 end, TArray<int32>& path, struct FPathQueryStats* stats = nullptr) const;
+
+	/**
+	 * Reverse Dijkstra from a set of goals. distance[i] is the cost of the cheapest
+	 * path from i to any goal (MAX_int32 if unreachable) and next[i] is the
+	 * neighbour to step to, INDEX_NONE at goals and unreachable nodes. With targets
+	 * the search stops once all of them that can reach a goal have their final
+	 * distance; nodes farther out are left at MAX_int32 or an overestimate.
+	 */
+	void ComputeDistanceField(const TArray<int32>& goals, TArray<int32>& distance, TArray<int32>& next, const TArray<int32>* targets = nullptr) const;
+
+	/** Admissible estimate of the cost between two nodes */
+	float Heuristic(int32 start, int32 end) const;
+
+private:
+	bool FindPathInternal(int32 start, int32 end, TArray<int32>& path, struct FPathQueryStats& stats) const;
+};
+
+typedef TSharedPtr<const FNodeGraphSnapshot, ESPMode::ThreadSafe> FNodeGraphSnapshotPtr;
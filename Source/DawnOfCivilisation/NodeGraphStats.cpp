@@ -0,0 +1,189 @@
+#include "NodeGraphStats.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/ScopeLock.h"
+#include "Algo/BinarySearch.h"
+
+DEFINE_STAT(STAT_NodeGraphGenerate);
+DEFINE_STAT(STAT_NodeGraphLoadBaked);
+DEFINE_STAT(STAT_NodeGraphPathfind);
+DEFINE_STAT(STAT_NodeGraphDistanceField);
+DEFINE_STAT(STAT_NodeGraphClosestNode);
+DEFINE_STAT(STAT_NodeGraphObstacleInRadius);
+DEFINE_STAT(STAT_NodeGraphRasterise);
+DEFINE_STAT(STAT_NodeGraphQueries);
+DEFINE_STAT(STAT_NodeGraphExpanded);
+
+namespace
+{
+	/* Bucket i holds queries that took [2^(i-1), 2^i) microseconds */
+	const int32 NumBuckets = 24;
+	const int32 MaxSlowest = 64;
+
+	/* One per thread that records queries, so path workers never wait on each other; the lock is only contended by Dump and Reset */
+	struct FProfilerState
+	{
+		FCriticalSection Lock;
+		int64 Histogram[NumBuckets];
+		int64 Queries;
+		int64 Failed;
+		int64 Expanded;
+		int64 PathLength;
+		int32 OpenPeak;
+		double TotalSeconds;
+		TArray<FPathQueryStats> Slowest;
+
+		FProfilerState() { ResetUnlocked(); }
+
+		void ResetUnlocked()
+		{
+			FMemory::Memzero(Histogram);
+			Queries = Failed = Expanded = PathLength = 0;
+			OpenPeak = 0;
+			TotalSeconds = 0.0;
+			Slowest.Reset();
+		}
+
+		void AddSlowest(const FPathQueryStats& stats)
+		{
+			// Kept sorted slowest first, only the tail ever gets replaced
+			if (Slowest.Num() < MaxSlowest || stats.Seconds > Slowest.Last().Seconds)
+			{
+				int32 index = Algo::UpperBoundBy(Slowest, -stats.Seconds, [](const FPathQueryStats& s) { return -s.Seconds; });
+				Slowest.Insert(stats, index);
+
+				if (Slowest.Num() > MaxSlowest)
+					Slowest.Pop(false);
+			}
+		}
+
+		void MergeUnlocked(const FProfilerState& other)
+		{
+			for (int32 i = 0; i < NumBuckets; ++i)
+				Histogram[i] += other.Histogram[i];
+
+			Queries += other.Queries;
+			Failed += other.Failed;
+			Expanded += other.Expanded;
+			PathLength += other.PathLength;
+			OpenPeak = FMath::Max(OpenPeak, other.OpenPeak);
+			TotalSeconds += other.TotalSeconds;
+
+			for (const FPathQueryStats& stats : other.Slowest)
+				AddSlowest(stats);
+		}
+	};
+
+	/* Every thread's state, kept after the thread exits so its queries still show up in the dump */
+	struct FProfilerRegistry
+	{
+		FCriticalSection Lock;
+		TArray<TUniquePtr<FProfilerState>> Threads;
+		double StartTime;
+
+		FProfilerRegistry() : StartTime(FPlatformTime::Seconds()) {}
+	};
+
+	FProfilerRegistry& GetRegistry()
+	{
+		static FProfilerRegistry registry;
+		return registry;
+	}
+
+	FProfilerState& GetThreadState()
+	{
+		static thread_local FProfilerState* state = NULL;
+
+		if (!state)
+		{
+			FProfilerRegistry& registry = GetRegistry();
+			FScopeLock lock(&registry.Lock);
+
+			state = registry.Threads.Add_GetRef(MakeUnique<FProfilerState>()).Get();
+		}
+
+		return *state;
+	}
+
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice DumpCommand(
+		TEXT("NodeGraph.DumpStats"),
+		TEXT("Prints node graph query latency histogram and the N slowest queries (default 10)"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& args, UWorld*, FOutputDevice& out)
+		{
+			FNodeGraphProfiler::Dump(out, args.Num() > 0 ? FCString::Atoi(*args[0]) : 10);
+		}));
+
+	FAutoConsoleCommand ResetCommand(
+		TEXT("NodeGraph.ResetStats"),
+		TEXT("Clears the node graph query statistics"),
+		FConsoleCommandDelegate::CreateStatic(&FNodeGraphProfiler::Reset));
+}
+
+void FNodeGraphProfiler::RecordQuery(const FPathQueryStats& stats)
+{
+	int32 bucket = FMath::Clamp(FMath::CeilLogTwo64((uint64)(stats.Seconds * 1000000.0) + 1), 0, NumBuckets - 1);
+
+	FProfilerState& state = GetThreadState();
+	FScopeLock lock(&state.Lock);
+
+	++state.Histogram[bucket];
+	++state.Queries;
+	state.Failed += stats.Success ? 0 : 1;
+	state.Expanded += stats.Expanded;
+	state.PathLength += stats.PathLength;
+	state.OpenPeak = FMath::Max(state.OpenPeak, stats.OpenPeak);
+	state.TotalSeconds += stats.Seconds;
+	state.AddSlowest(stats);
+}
+
+void FNodeGraphProfiler::RecordBuild(const TCHAR* kind, int32 nodes, double seconds)
+{
+	UE_LOG(LogTemp, Log, TEXT("Node graph %s: %d nodes in %.2fms"), kind, nodes, seconds * 1000.0);
+}
+
+void FNodeGraphProfiler::Dump(FOutputDevice& out, int32 slowest)
+{
+	FProfilerRegistry& registry = GetRegistry();
+	FScopeLock registryLock(&registry.Lock);
+
+	FProfilerState state;
+
+	for (auto& thread : registry.Threads)
+	{
+		FScopeLock lock(&thread->Lock);
+		state.MergeUnlocked(*thread);
+	}
+
+	double elapsed = FMath::Max(FPlatformTime::Seconds() - registry.StartTime, 0.001);
+	int64 queries = FMath::Max<int64>(state.Queries, 1);
+
+	out.Logf(TEXT("Node graph queries: %lld (%lld failed), %.1f/s, avg %.3fms, avg expanded %.1f, avg path %.1f, open peak %d"),
+		state.Queries, state.Failed, state.Queries / elapsed, state.TotalSeconds * 1000.0 / queries,
+		(double)state.Expanded / queries, (double)state.PathLength / queries, state.OpenPeak);
+
+	for (int32 i = 0; i < NumBuckets; ++i)
+	{
+		if (state.Histogram[i] > 0)
+			out.Logf(TEXT("  < %8lldus: %lld"), 1ll << i, state.Histogram[i]);
+	}
+
+	for (int32 i = 0; i < FMath::Min(slowest, state.Slowest.Num()); ++i)
+	{
+		const FPathQueryStats& s = state.Slowest[i];
+		out.Logf(TEXT("  #%d %.3fms start %d goal %d expanded %d open peak %d length %d%s"),
+			i + 1, s.Seconds * 1000.0, s.Start, s.End, s.Expanded, s.OpenPeak, s.PathLength, s.Success ? TEXT("") : TEXT(" (failed)"));
+	}
+}
+
+void FNodeGraphProfiler::Reset()
+{
+	FProfilerRegistry& registry = GetRegistry();
+	FScopeLock registryLock(&registry.Lock);
+
+	for (auto& thread : registry.Threads)
+	{
+		FScopeLock lock(&thread->Lock);
+		thread->ResetUnlocked();
+	}
+
+	registry.StartTime = FPlatformTime::Seconds();
+}
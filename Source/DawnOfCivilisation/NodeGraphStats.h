@@ -0,0 +1,46 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+
+DECLARE_STATS_GROUP(TEXT("NodeGraph"), STATGROUP_NodeGraph, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Generate"), STAT_NodeGraphGenerate, STATGROUP_NodeGraph, DAWNOFCIVILISATION_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Load Baked"), STAT_NodeGraphLoadBaked, STATGROUP_NodeGraph, DAWNOFCIVILISATION_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Pathfind"), STAT_NodeGraphPathfind, STATGROUP_NodeGraph, DAWNOFCIVILISATION_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Distance Field"), STAT_NodeGraphDistanceField, STATGROUP_NodeGraph, DAWNOFCIVILISATION_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("GetClosestNode"), STAT_NodeGraphClosestNode, STATGROUP_NodeGraph, DAWNOFCIVILISATION_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("IsObstacleInRadius"), STAT_NodeGraphObstacleInRadius, STATGROUP_NodeGraph, DAWNOFCIVILISATION_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Rasterise Obstacles"), STAT_NodeGraphRasterise, STATGROUP_NodeGraph, DAWNOFCIVILISATION_API);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Path Queries"), STAT_NodeGraphQueries, STATGROUP_NodeGraph, DAWNOFCIVILISATION_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Expanded Nodes"), STAT_NodeGraphExpanded, STATGROUP_NodeGraph, DAWNOFCIVILISATION_API);
+
+/** Counters for a single path query */
+struct FPathQueryStats
+{
+	int32 Start;
+	int32 End;
+	int32 Expanded;
+	int32 OpenPeak;
+	int32 PathLength;
+	bool Success;
+	double Seconds;
+
+	FPathQueryStats() : Start(INDEX_NONE), End(INDEX_NONE), Expanded(0), OpenPeak(0), PathLength(0), Success(false), Seconds(0.0) {}
+};
+
+/**
+ * Process-wide record of node graph queries and builds, safe to feed from the
+ * path workers. Queries are only recorded in builds with STATS. Dump it with
+ * the NodeGraph.DumpStats console command.
+ */
+class DAWNOFCIVILISATION_API FNodeGraphProfiler
+{
+	public:
+		static void RecordQuery(const FPathQueryStats& stats);
+		static void RecordBuild(const TCHAR* kind, int32 nodes, double seconds);
+
+		static void Dump(FOutputDevice& out, int32 slowest);
+		static void Reset();
+};
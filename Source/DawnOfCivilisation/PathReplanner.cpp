@@ -0,0 +1,257 @@
+#include "PathReplanner.h"
+#include "NodeGraph.h"
+
+static const float Infinity = MAX_flt;
+
+static float AddCost(float a, float b)
+{
+	return (a >= Infinity || b >= Infinity) ? Infinity : a + b;
+}
+
+UPathReplanner::UPathReplanner()
+	: Graph(NULL),
+	  Start(INDEX_NONE),
+	  LastStart(INDEX_NONE),
+	  Goal(INDEX_NONE),
+	  KeyModifier(0.0f)
+{
+}
+
+void UPathReplanner::BeginDestroy()
+{
+	if (Graph)
+		Graph->OnCostsChanged.Remove(CostsChangedHandle);
+
+	Super::BeginDestroy();
+}
+
+void UPathReplanner::Initialise(UNodeGraph* graph, int32 start, int32 goal)
+{
+	if (Graph)
+		Graph->OnCostsChanged.Remove(CostsChangedHandle);
+
+	Graph = graph;
+	Start = LastStart = start;
+	Goal = goal;
+
+	if (Graph)
+		CostsChangedHandle = Graph->OnCostsChanged.AddUObject(this, &UPathReplanner::OnCostsChanged);
+
+	Reset();
+}
+
+void UPathReplanner::Reset()
+{
+	Snapshot = Graph ? Graph->GetSnapshot() : nullptr;
+	Open.Reset();
+	PendingChanges.Reset();
+	KeyModifier = 0.0f;
+
+	if (!Snapshot.IsValid())
+		return;
+
+	if (!Snapshot->Topology->IsValidNode(Start))
+		Start = LastStart = Goal;
+
+	int32 num = Snapshot->Num();
+
+	G.Init(Infinity, num);
+	Rhs.Init(Infinity, num);
+	QueuedKeys.SetNum(num);
+	Queued.Init(false, num);
+
+	if (Snapshot->Topology->IsValidNode(Goal))
+	{
+		Rhs[Goal] = 0.0f;
+		UpdateVertex(Goal);
+	}
+}
+
+void UPathReplanner::OnCostsChanged(const TArray<int32>& nodes)
+{
+	PendingChanges.Append(nodes);
+}
+
+float UPathReplanner::EdgeCost(int32 from, int32 to) const
+{
+	return Snapshot->IsPassable(to) ? FMath::Max(Snapshot->Costs[from], 0) : Infinity;
+}
+
+float UPathReplanner::Heuristic(int32 a, int32 b) const
+{
+	const FNodeGraphTopology& topology = *Snapshot->Topology;
+
+	if (topology.MaxEdgeAngle <= 0.0f)
+		return 0.0f;
+
+	// Passable costs are always >= 1, so this stays admissible whatever costs change later
+	float dot = FMath::Clamp(FVector::DotProduct(topology.Directions[a], topology.Directions[b]), -1.0f, 1.0f);
+	return acosf(dot) / topology.MaxEdgeAngle;
+}
+
+FReplannerKey UPathReplanner::CalculateKey(int32 node) const
+{
+	float m = FMath::Min(G[node], Rhs[node]);
+	return { AddCost(m, Heuristic(Start, node) + KeyModifier), m };
+}
+
+void UPathReplanner::UpdateVertex(int32 node)
+{
+	if (node != Goal)
+	{
+		float rhs = Infinity;
+
+		for (int32 child : Snapshot->Topology->GetNeighbours(node))
+			rhs = FMath::Min(rhs, AddCost(EdgeCost(node, child), G[child]));
+
+		Rhs[node] = rhs;
+	}
+
+	if (G[node] != Rhs[node])
+	{
+		QueuedKeys[node] = CalculateKey(node);
+		Queued[node] = true;
+		Open.HeapPush({ QueuedKeys[node], node });
+	}
+	else
+		Queued[node] = false;
+}
+
+bool UPathReplanner::TopKey(FReplannerKey& key)
+{
+	while (Open.Num() > 0)
+	{
+		const FReplannerEntry& top = Open.HeapTop();
+
+		if (Queued[top.Node] && QueuedKeys[top.Node] == top.Key)
+		{
+			key = top.Key;
+			return true;
+		}
+
+		Open.HeapPopDiscard();
+	}
+
+	return false;
+}
+
+void UPathReplanner::ComputeShortestPath()
+{
+	FReplannerKey top;
+
+	while (TopKey(top) && (top < CalculateKey(Start) || Rhs[Start] > G[Start]))
+	{
+		int32 node = Open.HeapTop().Node;
+		Open.HeapPopDiscard();
+		Queued[node] = false;
+
+		FReplannerKey key = CalculateKey(node);
+
+		if (top < key)
+		{
+			QueuedKeys[node] = key;
+			Queued[node] = true;
+			Open.HeapPush({ key, node });
+		}
+		else if (G[node] > Rhs[node])
+		{
+			G[node] = Rhs[node];
+
+			for (int32 child : Snapshot->Topology->GetNeighbours(node))
+				UpdateVertex(child);
+		}
+		else
+		{
+			G[node] = Infinity;
+			UpdateVertex(node);
+
+			for (int32 child : Snapshot->Topology->GetNeighbours(node))
+				UpdateVertex(child);
+		}
+	}
+}
+
+bool UPathReplanner::ReplanNative(int32 current, TArray<int32>& path)
+{
+	path.Reset();
+
+	if (!Graph)
+		return false;
+
+	auto snapshot = Graph->GetSnapshot();
+
+	if (!snapshot.IsValid() || !snapshot->Topology->IsValidNode(current))
+		return false;
+
+	// A regenerated graph invalidates the whole search tree
+	if (!Snapshot.IsValid() || Snapshot->Topology != snapshot->Topology)
+	{
+		Start = LastStart = current;
+		Reset();
+	}
+
+	Snapshot = snapshot;
+
+	if (!Snapshot->Topology->IsValidNode(Goal))
+		return false;
+
+	if (current != LastStart)
+	{
+		KeyModifier += Heuristic(LastStart, current);
+		Start = LastStart = current;
+	}
+
+	for (int32 node : PendingChanges)
+	{
+		UpdateVertex(node);
+
+		for (int32 child : Snapshot->Topology->GetNeighbours(node))
+			UpdateVertex(child);
+	}
+
+	PendingChanges.Reset();
+	ComputeShortestPath();
+
+	if (G[Start] >= Infinity)
+		return false;
+
+	int32 node = Start;
+	path.Add(node);
+
+	while (node != Goal && path.Num() <= Snapshot->Num())
+	{
+		int32 best = INDEX_NONE;
+		float bestCost = Infinity;
+
+		for (int32 child : Snapshot->Topology->GetNeighbours(node))
+		{
+			float cost = AddCost(EdgeCost(node, child), G[child]);
+
+			if (cost < bestCost)
+				best = child, bestCost = cost;
+		}
+
+		if (best == INDEX_NONE)
+			return false;
+
+		node = best;
+		path.Add(node);
+	}
+
+	return node == Goal;
+}
+
+bool UPathReplanner::Replan(int current, TArray<UGraphNode*>& path)
+{
+	TArray<int32> ids;
+
+	if (!ReplanNative(current, ids))
+		return false;
+
+	path.Reset();
+
+	for (auto id : ids)
+		path.Add(Graph->GetNodeByIndex(id));
+
+	return true;
+}
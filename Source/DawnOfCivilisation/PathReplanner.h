@@ -0,0 +1,89 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/NoExportTypes.h"
+#include "NodeGraphSnapshot.h"
+#include "PathReplanner.generated.h"
+
+class UNodeGraph;
+class UGraphNode;
+
+struct FReplannerKey
+{
+	float Primary;
+	float Secondary;
+
+	bool operator<(const FReplannerKey& other) const
+	{
+		return Primary < other.Primary || (Primary == other.Primary && Secondary < other.Secondary);
+	}
+
+	bool operator==(const FReplannerKey& other) const { return Primary == other.Primary && Secondary == other.Secondary; }
+};
+
+struct FReplannerEntry
+{
+	FReplannerKey Key;
+	int32 Node;
+
+	bool operator<(const FReplannerEntry& other) const { return Key < other.Key; }
+};
+
+/**
+ * D* Lite replanner for one agent and goal. Keeps its search tree between
+ * calls and only repairs the parts affected by node cost changes, so an agent
+ * can call Replan every time it reaches a node or the graph changes.
+ */
+UCLASS(BlueprintType)
+class DAWNOFCIVILISATION_API UPathReplanner : public UObject
+{
+	GENERATED_BODY()
+
+	public:
+		UPathReplanner();
+
+		void BeginDestroy() override;
+
+		void Initialise(UNodeGraph* graph, int32 start, int32 goal);
+
+		/* Path from the agent's current node to the goal, repaired after any cost changes */
+		UFUNCTION(BlueprintCallable)
+		bool Replan(int current, TArray<UGraphNode*>& path);
+
+		bool ReplanNative(int32 current, TArray<int32>& path);
+
+		UFUNCTION(BlueprintCallable)
+		int GetGoal() const { return Goal; }
+
+	private:
+		void Reset();
+		void OnCostsChanged(const TArray<int32>& nodes);
+
+		float EdgeCost(int32 from, int32 to) const;
+		float Heuristic(int32 a, int32 b) const;
+		FReplannerKey CalculateKey(int32 node) const;
+		void UpdateVertex(int32 node);
+		bool TopKey(FReplannerKey& key);
+		void ComputeShortestPath();
+
+		UPROPERTY()
+		UNodeGraph* Graph;
+
+		FNodeGraphSnapshotPtr Snapshot;
+		FDelegateHandle CostsChangedHandle;
+
+		int32 Start;
+		int32 LastStart;
+		int32 Goal;
+		float KeyModifier;
+
+		TArray<float> G;
+		TArray<float> Rhs;
+
+		/* Heap entries are only live while they match QueuedKeys and the node is queued */
+		TArray<FReplannerEntry> Open;
+		TArray<FReplannerKey> QueuedKeys;
+		TBitArray<> Queued;
+
+		TSet<int32> PendingChanges;
+};
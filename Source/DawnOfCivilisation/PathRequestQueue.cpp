@@ -0,0 +1,360 @@
+#include "PathRequestQueue.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+
+struct FPathQueueRequest
+{
+	int32 Handle;
+	int32 Start;
+	int32 End;
+	int32 Priority;
+	double SubmitTime;
+};
+
+struct FPathQueueResult
+{
+	FPathQueueRequest Request;
+	bool Success;
+	TArray<int32> Path;
+	uint32 Version;
+	double DispatchTime;
+};
+
+struct FPathQueueRequestPredicate
+{
+	// Highest priority first, oldest first within a priority
+	bool operator()(const FPathQueueRequest& a, const FPathQueueRequest& b) const
+	{
+		return a.Priority != b.Priority ? a.Priority > b.Priority : a.Handle < b.Handle;
+	}
+};
+
+struct FPathQueueShared
+{
+	FCriticalSection Lock;
+	TArray<FPathQueueRequest> Pending;
+	TSet<int32> Cancelled;
+	TArray<FPathQueueResult> Completed;
+	FNodeGraphSnapshotPtr Snapshot;
+	FEvent* WorkEvent;
+	FThreadSafeBool Stop;
+
+	FPathQueueShared() : WorkEvent(FPlatformProcess::GetSynchEventFromPool(false)), Stop(false) {}
+	~FPathQueueShared() { FPlatformProcess::ReturnSynchEventToPool(WorkEvent); }
+};
+
+class FPathQueueWorker : public FRunnable
+{
+	public:
+		FPathQueueWorker(TSharedRef<FPathQueueShared, ESPMode::ThreadSafe> shared) : Shared(shared) {}
+
+		uint32 Run() override
+		{
+			while (!Shared->Stop)
+			{
+				FPathQueueRequest request;
+				FNodeGraphSnapshotPtr snapshot;
+				bool hasWork = false;
+				bool moreWork = false;
+
+				{
+					FScopeLock lock(&Shared->Lock);
+
+					while (Shared->Pending.Num() > 0)
+					{
+						Shared->Pending.HeapPop(request, FPathQueueRequestPredicate(), false);
+
+						if (Shared->Cancelled.Remove(request.Handle) == 0)
+						{
+							snapshot = Shared->Snapshot;
+							hasWork = true;
+							break;
+						}
+					}
+
+					moreWork = Shared->Pending.Num() > 0;
+				}
+
+				if (!hasWork)
+				{
+					// Sleeps until a request is queued or the queue shuts down
+					Shared->WorkEvent->Wait();
+					continue;
+				}
+
+				// Triggers coalesce on the auto-reset event, so pass the wake-up on to another idle worker
+				if (moreWork)
+					Shared->WorkEvent->Trigger();
+
+				FPathQueueResult result;
+				result.Request = request;
+				result.Version = snapshot.IsValid() ? snapshot->Version : 0;
+				result.DispatchTime = FPlatformTime::Seconds();
+				result.Success = snapshot.IsValid() && snapshot->FindPath(request.Start, request.End, result.Path);
+
+				FScopeLock lock(&Shared->Lock);
+				Shared->Completed.Add(MoveTemp(result));
+			}
+
+			// Wakes the next worker, the triggers from StopWorkers may have coalesced
+			Shared->WorkEvent->Trigger();
+
+			return 0;
+		}
+
+	private:
+		TSharedRef<FPathQueueShared, ESPMode::ThreadSafe> Shared;
+};
+
+UPathRequestQueue::UPathRequestQueue()
+	: MaxResultsPerFrame(16),
+	  Graph(NULL),
+	  NextHandle(1),
+	  QueueLatencyTotal(0.0),
+	  TotalLatencyTotal(0.0),
+	  ThroughputWindowStart(0.0),
+	  ThroughputWindowCount(0)
+{
+}
+
+void UPathRequestQueue::BeginDestroy()
+{
+	StopWorkers();
+	Super::BeginDestroy();
+}
+
+void UPathRequestQueue::Initialise(UNodeGraph* graph, int numWorkers, int maxResultsPerFrame)
+{
+	StopWorkers();
+
+	Graph = graph;
+	MaxResultsPerFrame = maxResultsPerFrame;
+	Callbacks.Empty();
+	Stats = FPathQueueStats();
+	QueueLatencyTotal = TotalLatencyTotal = 0.0;
+	ThroughputWindowStart = FPlatformTime::Seconds();
+	ThroughputWindowCount = 0;
+
+	TSharedRef<FPathQueueShared, ESPMode::ThreadSafe> shared = MakeShareable(new FPathQueueShared());
+	shared->Snapshot = Graph ? Graph->GetSnapshot() : nullptr;
+	Shared = shared;
+
+	for (int i = 0; i < FMath::Max(1, numWorkers); ++i)
+	{
+		FRunnable* worker = new FPathQueueWorker(shared);
+		FString name = FString::Printf(TEXT("PathWorker%d"), i);
+
+		Workers.Add(worker);
+		Threads.Add(FRunnableThread::Create(worker, *name, 0, TPri_BelowNormal));
+	}
+}
+
+void UPathRequestQueue::StopWorkers()
+{
+	if (Shared.IsValid())
+	{
+		Shared->Stop = true;
+
+		for (int i = 0; i < Threads.Num(); ++i)
+			Shared->WorkEvent->Trigger();
+	}
+
+	for (auto thread : Threads)
+	{
+		if (thread)
+		{
+			thread->WaitForCompletion();
+			delete thread;
+		}
+	}
+
+	for (auto worker : Workers)
+		delete worker;
+
+	Threads.Empty();
+	Workers.Empty();
+	Shared.Reset();
+}
+
+int32 UPathRequestQueue::Enqueue(int32 start, int32 end, int32 priority)
+{
+	if (!Shared.IsValid())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Path request submitted before the queue was initialised"));
+		return 0;
+	}
+
+	FPathQueueRequest request;
+	request.Handle = NextHandle++;
+	request.Start = start;
+	request.End = end;
+	request.Priority = priority;
+	request.SubmitTime = FPlatformTime::Seconds();
+
+	{
+		FScopeLock lock(&Shared->Lock);
+		Shared->Pending.HeapPush(request, FPathQueueRequestPredicate());
+	}
+
+	Shared->WorkEvent->Trigger();
+
+	return request.Handle;
+}
+
+int UPathRequestQueue::Submit(int start, int end, int priority, FOnPathRequestComplete onComplete)
+{
+	int32 handle = Enqueue(start, end, priority);
+
+	if (handle != 0)
+		Callbacks.Add(handle).Dynamic = onComplete;
+
+	return handle;
+}
+
+int UPathRequestQueue::SubmitNative(int start, int end, int priority, FPathRequestCallback onComplete)
+{
+	int32 handle = Enqueue(start, end, priority);
+
+	if (handle != 0)
+		Callbacks.Add(handle).Native = MoveTemp(onComplete);
+
+	return handle;
+}
+
+int UPathRequestQueue::Supersede(int handle, int start, int end, int priority, FOnPathRequestComplete onComplete)
+{
+	Cancel(handle);
+	return Submit(start, end, priority, onComplete);
+}
+
+bool UPathRequestQueue::Cancel(int handle)
+{
+	if (Callbacks.Remove(handle) == 0)
+		return false;
+
+	// Workers skip it if it hasn't started; a finished result is dropped in Tick
+	FScopeLock lock(&Shared->Lock);
+	Shared->Cancelled.Add(handle);
+	++Stats.Cancelled;
+
+	return true;
+}
+
+void UPathRequestQueue::Tick(float dt)
+{
+	if (!Shared.IsValid())
+		return;
+
+	// Queries dispatched from now on see the latest costs
+	auto snapshot = Graph->GetSnapshot();
+
+	TArray<FPathQueueResult> results;
+
+	{
+		FScopeLock lock(&Shared->Lock);
+		Shared->Snapshot = snapshot;
+
+		const int32 maxResults = FMath::Max(1, MaxResultsPerFrame);
+		int32 count = 0;
+
+		results.Reserve(FMath::Min(Shared->Completed.Num(), maxResults));
+
+		// Cancelled results are dropped without using up the per-frame budget
+		for (; count < Shared->Completed.Num() && results.Num() < maxResults; ++count)
+		{
+			if (Shared->Cancelled.Remove(Shared->Completed[count].Request.Handle) == 0)
+				results.Add(MoveTemp(Shared->Completed[count]));
+		}
+
+		Shared->Completed.RemoveAt(0, count, false);
+		Stats.Pending = Shared->Pending.Num() + Shared->Completed.Num();
+	}
+
+	TArray<FPathQueueRequest> stale;
+
+	for (auto& result : results)
+	{
+		if (IsBlocked(result, snapshot))
+			stale.Add(result.Request);
+		else
+			Deliver(result);
+	}
+
+	// Paths planned on older costs that now cross an obstacle are planned again under the same handle
+	if (stale.Num() > 0)
+	{
+		{
+			FScopeLock lock(&Shared->Lock);
+
+			for (auto& request : stale)
+				Shared->Pending.HeapPush(request, FPathQueueRequestPredicate());
+		}
+
+		for (int i = 0; i < stale.Num(); ++i)
+			Shared->WorkEvent->Trigger();
+	}
+
+	double now = FPlatformTime::Seconds();
+
+	if (now - ThroughputWindowStart >= 1.0)
+	{
+		Stats.Throughput = (float)(ThroughputWindowCount / (now - ThroughputWindowStart));
+		ThroughputWindowStart = now;
+		ThroughputWindowCount = 0;
+	}
+}
+
+bool UPathRequestQueue::IsBlocked(const FPathQueueResult& result, const FNodeGraphSnapshotPtr& snapshot) const
+{
+	if (!result.Success || !snapshot.IsValid() || result.Version == snapshot->Version || !Callbacks.Contains(result.Request.Handle))
+		return false;
+
+	for (int32 i = 1; i < result.Path.Num(); ++i)
+	{
+		if (!snapshot->IsPassable(result.Path[i]))
+			return true;
+	}
+
+	return false;
+}
+
+void UPathRequestQueue::Deliver(FPathQueueResult& result)
+{
+	FPathRequestCallbacks callbacks;
+	const int32 handle = result.Request.Handle;
+
+	if (!Callbacks.RemoveAndCopyValue(handle, callbacks))
+		return;
+
+	double now = FPlatformTime::Seconds();
+	double queueLatency = (result.DispatchTime - result.Request.SubmitTime) * 1000.0;
+
+	++Stats.Delivered;
+	++ThroughputWindowCount;
+
+	QueueLatencyTotal += queueLatency;
+	TotalLatencyTotal += (now - result.Request.SubmitTime) * 1000.0;
+
+	Stats.AverageQueueLatency = (float)(QueueLatencyTotal / Stats.Delivered);
+	Stats.AverageTotalLatency = (float)(TotalLatencyTotal / Stats.Delivered);
+	Stats.MaxQueueLatency = FMath::Max(Stats.MaxQueueLatency, (float)queueLatency);
+
+	if (callbacks.Native)
+		callbacks.Native(handle, result.Success, result.Path);
+
+	if (callbacks.Dynamic.IsBound())
+	{
+		TArray<UGraphNode*> path;
+		path.Reserve(result.Path.Num());
+
+		for (auto id : result.Path)
+			path.Add(Graph->GetNodeByIndex(id));
+
+		callbacks.Dynamic.Execute(handle, result.Success, path);
+	}
+}
+
+FPathQueueStats UPathRequestQueue::GetStats() const
+{
+	return Stats;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/NoExportTypes.h"
+#include "Tickable.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "NodeGraph.h"
+#include "PathRequestQueue.generated.h"
+
+DECLARE_DYNAMIC_DELEGATE_ThreeParams(FOnPathRequestComplete, int32, Handle, bool, Success, const TArray<UGraphNode*>&, Path);
+
+typedef TFunction<void(int32 handle, bool success, const TArray<int32>& path)> FPathRequestCallback;
+
+USTRUCT(BlueprintType)
+struct FPathQueueStats
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	int Pending;
+
+	UPROPERTY(BlueprintReadOnly)
+	int Delivered;
+
+	UPROPERTY(BlueprintReadOnly)
+	int Cancelled;
+
+	/* Results delivered per second over the last full second */
+	UPROPERTY(BlueprintReadOnly)
+	float Throughput;
+
+	/* Time spent waiting for a worker, in milliseconds */
+	UPROPERTY(BlueprintReadOnly)
+	float AverageQueueLatency;
+
+	UPROPERTY(BlueprintReadOnly)
+	float MaxQueueLatency;
+
+	/* Submit to delivery, in milliseconds */
+	UPROPERTY(BlueprintReadOnly)
+	float AverageTotalLatency;
+
+	FPathQueueStats() : Pending(0), Delivered(0), Cancelled(0), Throughput(0.0f),
+		AverageQueueLatency(0.0f), MaxQueueLatency(0.0f), AverageTotalLatency(0.0f) {}
+};
+
+struct FPathRequestCallbacks
+{
+	FOnPathRequestComplete Dynamic;
+	FPathRequestCallback Native;
+};
+
+/**
+ * Runs UNodeGraph path queries on worker threads against immutable graph
+ * snapshots and hands the results back on the game thread, a capped number
+ * per frame.
+ */
+UCLASS(BlueprintType)
+class DAWNOFCIVILISATION_API UPathRequestQueue : public UObject, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+	public:
+		UPathRequestQueue();
+
+		void BeginDestroy() override;
+
+		void Tick(float dt) override;
+		bool IsTickable() const override { return Graph != NULL; }
+		TStatId GetStatId() const override { RETURN_QUICK_DECLARE_CYCLE_STAT(UPathRequestQueue, STATGROUP_Tickables); }
+
+		UFUNCTION(BlueprintCallable)
+		void Initialise(UNodeGraph* graph, int numWorkers = 2, int maxResultsPerFrame = 16);
+
+		UFUNCTION(BlueprintCallable)
+		int Submit(int start, int end, int priority, FOnPathRequestComplete onComplete);
+
+		int SubmitNative(int start, int end, int priority, FPathRequestCallback onComplete);
+
+		/* Cancels an existing request and submits its replacement */
+		UFUNCTION(BlueprintCallable)
+		int Supersede(int handle, int start, int end, int priority, FOnPathRequestComplete onComplete);
+
+		UFUNCTION(BlueprintCallable)
+		bool Cancel(int handle);
+
+		UFUNCTION(BlueprintCallable)
+		FPathQueueStats GetStats() const;
+
+		UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		int MaxResultsPerFrame;
+
+	private:
+		int32 Enqueue(int32 start, int32 end, int32 priority);
+		void StopWorkers();
+		bool IsBlocked(const struct FPathQueueResult& result, const FNodeGraphSnapshotPtr& snapshot) const;
+		void Deliver(struct FPathQueueResult& result);
+
+		UPROPERTY()
+		UNodeGraph* Graph;
+
+		TSharedPtr<struct FPathQueueShared, ESPMode::ThreadSafe> Shared;
+		TArray<FRunnable*> Workers;
+		TArray<FRunnableThread*> Threads;
+		TMap<int32, FPathRequestCallbacks> Callbacks;
+		int32 NextHandle;
+
+		FPathQueueStats Stats;
+		double QueueLatencyTotal;
+		double TotalLatencyTotal;
+		double ThroughputWindowStart;
+		int32 ThroughputWindowCount;
+};
@@ -13,7 +13,8 @@ APlanet::APlanet()
 	: EditorDivisions(3),
 	  PlayDivisions(6),
 	  Radius(3000.0f),
-	  Seed(0)
+	  Seed(0),
+	  RandomSeed(true)
 {
 	PrimaryActorTick.bCanEverTick = false;
 
@@ -58,7 +59,8 @@ void APlanet::BeginPlay()
 
 void APlanet::Generate()
 {
-	Seed = time(0);
+	if (RandomSeed)
+		Seed = time(0);
 
 	RandomStream = FRandomStream(Seed);
 	FPlanetPreset preset = Presets[Preset];
@@ -85,14 +87,27 @@ void APlanet::Generate()
 		terrain->GenerateHeights = preset.TerrainNoise.GenerateHeights;
 		terrain->Seed = Seed;
 		terrain->Collidable = true;
+		terrain->TerrainEdits = TerrainEdits;
+
+		FVector sand = preset.LandFeatures.BeachColour.GetValue(RandomStream);
+		FVector grass = preset.LandFeatures.LandColour.GetValue(RandomStream);
+		FVector rock = preset.LandFeatures.MountainColour.GetValue(RandomStream);
+
+		terrain->VertexColouring = true;
+		terrain->BeachColour = FLinearColor(sand);
+		terrain->LandColour = FLinearColor(grass);
+		terrain->MountainColour = FLinearColor(rock);
+
+		// Heights, edits and colours all follow from the values above
+		terrain->Regenerate();
 
 		if (PlanetMaterials.Contains(EPlanetComponent::Terrain) && PlanetMaterials[EPlanetComponent::Terrain])
 		{
 			UMaterialInstanceDynamic* mat = terrain->Mesh->CreateDynamicMaterialInstance(0, PlanetMaterials[EPlanetComponent::Terrain]);
 			mat->SetScalarParameterValue(FName("Radius"), Radius);
-			mat->SetVectorParameterValue(FName("Sand Colour"), preset.LandFeatures.BeachColour.GetValue(RandomStream));
-			mat->SetVectorParameterValue(FName("Grass Colour"), preset.LandFeatures.LandColour.GetValue(RandomStream));
-			mat->SetVectorParameterValue(FName("Rock Colour"), preset.LandFeatures.MountainColour.GetValue(RandomStream));
+			mat->SetVectorParameterValue(FName("Sand Colour"), sand);
+			mat->SetVectorParameterValue(FName("Grass Colour"), grass);
+			mat->SetVectorParameterValue(FName("Rock Colour"), rock);
 			terrain->Mesh->SetMaterial(0, mat);
 		}
 	}
@@ -149,6 +164,31 @@ void APlanet::Generate()
 	}
 }
 
+bool APlanet::Regenerate(int32 seed, int preset, const TArray<FTerrainEdit>& edits)
+{
+	if (!Presets.IsValidIndex(preset))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Planet preset %d does not exist"), preset);
+		return false;
+	}
+
+	Seed = seed;
+	Preset = preset;
+	TerrainEdits = edits;
+
+	// Only this build reuses the seed, a later Generate still follows the RandomSeed setting
+	TGuardValue<bool> keepSeed(RandomSeed, false);
+	Generate();
+
+	return true;
+}
+
+AGeosphere* APlanet::GetTerrain() const
+{
+	UChildActorComponent* const* component = PlanetComponents.Find(EPlanetComponent::Terrain);
+	return component && *component ? Cast<AGeosphere>((*component)->GetChildActor()) : NULL;
+}
+
 void APlanet::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
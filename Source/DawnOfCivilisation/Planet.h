@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "Geosphere.h"
 #include "Planet.generated.h"
 
 UENUM(BlueprintType)
@@ -174,6 +175,14 @@ class DAWNOFCIVILISATION_API APlanet : public AActor
 		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Generation")
 		int32 Seed;
 
+		/* Picks a new Seed every time the planet is generated, turn off to rebuild the same world */
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Generation")
+		bool RandomSeed;
+
+		/* Handed to the terrain on generation */
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Generation")
+		TArray<FTerrainEdit> TerrainEdits;
+
 		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Generation")
 		TArray<FPlanetPreset> Presets;
 
@@ -189,6 +198,13 @@ class DAWNOFCIVILISATION_API APlanet : public AActor
 		UFUNCTION(BlueprintCallable)
 		float GetScalarRangeValue(FScalarRange range) { return range.GetValue(RandomStream); }
 
+		/* Deterministically rebuilds the planet from a seed, preset and terrain edits, as when loading a save */
+		UFUNCTION(BlueprintCallable)
+		bool Regenerate(int32 seed, int preset, const TArray<FTerrainEdit>& edits);
+
+		UFUNCTION(BlueprintCallable)
+		AGeosphere* GetTerrain() const;
+
 	protected:
 		virtual void BeginPlay() override;
 		virtual void OnConstruction(const FTransform& Transform) override;
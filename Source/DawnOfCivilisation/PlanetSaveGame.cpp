@@ -0,0 +1,179 @@
+#include "PlanetSaveGame.h"
+#include "Planet.h"
+#include "Building.h"
+#include "EngineUtils.h"
+#include "Kismet/GameplayStatics.h"
+#include "HAL/PlatformTime.h"
+
+static const uint32 PlanetSaveMagic = 0x54454E50; // "PNET"
+static const uint32 PlanetSaveVersion = 1;
+
+FArchive& operator<<(FArchive& ar, FGameProgress& p)
+{
+	for (int32 i = 0; i < MaxResourceTypes; ++i)
+		ar << p.Resources[i];
+
+	return ar << p.UnlockedResources << p.UnlockedBuildings << p.CompletedMilestones << p.UntrackedEnergy;
+}
+
+UPlanetSaveGame::UPlanetSaveGame()
+	: Valid(false), Seed(0), Preset(0)
+{
+}
+
+void UPlanetSaveGame::Serialize(FArchive& ar)
+{
+	Super::Serialize(ar);
+
+	// Nothing here is a UPROPERTY, tagged serialisation would cost more than the data itself
+	uint32 magic = PlanetSaveMagic;
+	uint32 version = PlanetSaveVersion;
+
+	ar << magic << version;
+
+	if (ar.IsLoading() && (magic != PlanetSaveMagic || version != PlanetSaveVersion))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Unsupported planet save (version %u)"), version);
+		Valid = false;
+		return;
+	}
+
+	ar << Seed << Preset << PresetName << TerrainEdits << Buildings << Progress;
+
+	if (ar.IsLoading())
+		Valid = true;
+}
+
+UPlanetSaveGame* UPlanetSaveGame::CaptureGame(APlanet* planet, UGameManager* manager)
+{
+	if (!planet || !manager || !planet->Presets.IsValidIndex(planet->Preset))
+		return NULL;
+
+	UPlanetSaveGame* save = NewObject<UPlanetSaveGame>();
+
+	save->Valid = true;
+	save->Seed = planet->Seed;
+	save->Preset = planet->Preset;
+	save->PresetName = planet->Presets[planet->Preset].Name;
+
+	// The terrain has the edits made since generation as well as the ones it was generated with
+	AGeosphere* terrain = planet->GetTerrain();
+	save->TerrainEdits = terrain ? terrain->TerrainEdits : planet->TerrainEdits;
+
+	for (TActorIterator<AActor> it(planet->GetWorld()); it; ++it)
+	{
+		// Building blueprints implement the interface without a native IBuilding to cast to
+		if (!it->Implements<UBuilding>() || it->IsPendingKill())
+			continue;
+
+		FSavedBuilding saved;
+		saved.Name = IBuilding::Execute_GetBuildingName(*it).ToString();
+		saved.Location = it->GetActorLocation();
+		saved.Rotation = it->GetActorRotation();
+
+		save->Buildings.Add(saved);
+	}
+
+	manager->SaveProgress(save->Progress);
+
+	return save;
+}
+
+bool UPlanetSaveGame::SaveToSlot(APlanet* planet, UGameManager* manager, const FString& slot)
+{
+	UPlanetSaveGame* save = CaptureGame(planet, manager);
+
+	TArray<uint8> bytes;
+
+	if (!save || !UGameplayStatics::SaveGameToMemory(save, bytes))
+		return false;
+
+	UE_LOG(LogTemp, Log, TEXT("Saving '%s': %d bytes, %d buildings, %d terrain edits"), *slot, bytes.Num(), save->Buildings.Num(), save->TerrainEdits.Num());
+
+	return UGameplayStatics::SaveDataToSlot(bytes, slot, 0);
+}
+
+bool UPlanetSaveGame::LoadFromSlot(APlanet* planet, UGameManager* manager, const FString& slot)
+{
+	UPlanetSaveGame* save = Cast<UPlanetSaveGame>(UGameplayStatics::LoadGameFromSlot(slot, 0));
+
+	if (!save)
+	{
+		UE_LOG(LogTemp, Error, TEXT("No planet save in slot '%s'"), *slot);
+		return false;
+	}
+
+	return save->Restore(planet, manager);
+}
+
+bool UPlanetSaveGame::Restore(APlanet* planet, UGameManager* manager)
+{
+	if (!Valid || !planet || !manager)
+		return false;
+
+	double begin = FPlatformTime::Seconds();
+
+	if (!planet->Presets.IsValidIndex(Preset) || planet->Presets[Preset].Name != PresetName)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Planet preset '%s' is no longer at index %d"), *PresetName, Preset);
+		return false;
+	}
+
+	UWorld* world = planet->GetWorld();
+
+	// Gone before the terrain regenerates, so its obstacle scan doesn't pick up the old buildings
+	for (TActorIterator<AActor> it(world); it; ++it)
+	{
+		if (it->Implements<UBuilding>())
+			it->Destroy();
+	}
+
+	// Their economy records and energy sources would otherwise keep running next to the respawned ones
+	manager->ClearBuildingState();
+
+	if (!planet->Regenerate(Seed, Preset, TerrainEdits))
+		return false;
+
+	AGeosphere* terrain = planet->GetTerrain();
+	UNodeGraph* graph = terrain && terrain->NodeGraph && terrain->NodeGraph->GetNumNodes() > 0 ? terrain->NodeGraph : NULL;
+
+	int32 spawned = 0;
+
+	for (const FSavedBuilding& saved : Buildings)
+	{
+		int32 index = manager->GetBuildingIndex(saved.Name);
+
+		if (index < 0)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Saved building '%s' is no longer in the catalogue"), *saved.Name);
+			continue;
+		}
+
+		// The catalogue streams blueprints in the background, a load can't wait for that
+		const FBuildingDesc& desc = manager->GetBuildings()[index];
+		UClass* buildingClass = desc.Building ? *desc.Building : desc.BuildingClass.LoadSynchronous();
+
+		if (!buildingClass)
+			continue;
+
+		FActorSpawnParameters params;
+		params.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+		AActor* building = world->SpawnActor<AActor>(buildingClass, saved.Location, saved.Rotation, params);
+
+		if (!building)
+			continue;
+
+		// A graph built before the spawn has already scanned for obstacles, later ones find the tag themselves
+		if (graph && building->ActorHasTag("PlanetObstacle"))
+			graph->AddObstacle(building);
+
+		++spawned;
+	}
+
+	manager->LoadProgress(Progress);
+
+	UE_LOG(LogTemp, Log, TEXT("Restored planet %d with %d/%d buildings in %.1fms"), Seed, spawned, Buildings.Num(), (FPlatformTime::Seconds() - begin) * 1000.0);
+
+	return true;
+}
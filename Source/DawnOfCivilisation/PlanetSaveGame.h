@@ -0,0 +1,89 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/SaveGame.h"
+#include "GameManager.h"
+#include "Geosphere.h"
+#include "PlanetSaveGame.generated.h"
+
+class APlanet;
+
+/* Everything UGameManager keeps between sessions */
+struct FGameProgress
+{
+	int32 Resources[MaxResourceTypes];
+	uint8 UnlockedResources;
+	TArray<FString> UnlockedBuildings;
+	TArray<FString> CompletedMilestones;
+	double UntrackedEnergy;
+
+	FGameProgress() : UnlockedResources(0), UntrackedEnergy(0.0)
+	{
+		FMemory::Memzero(Resources);
+	}
+
+	friend FArchive& operator<<(FArchive& ar, FGameProgress& p);
+};
+
+/* A placed building, respawned from the catalogue entry of the same name */
+struct FSavedBuilding
+{
+	FString Name;
+	FVector Location;
+	FRotator Rotation;
+
+	friend FArchive& operator<<(FArchive& ar, FSavedBuilding& b)
+	{
+		return ar << b.Name << b.Location << b.Rotation;
+	}
+};
+
+/**
+ * Stores the inputs the world is generated from (seed and preset) and the
+ * changes made since: terrain edits, buildings and game progress. Loading
+ * regenerates the planet instead of reading meshes or the node graph back,
+ * so a save is a few kilobytes.
+ */
+UCLASS()
+class DAWNOFCIVILISATION_API UPlanetSaveGame : public USaveGame
+{
+	GENERATED_BODY()
+
+	public:
+		UPlanetSaveGame();
+
+		void Serialize(FArchive& ar) override;
+
+		/* Snapshot of the planet, every actor implementing IBuilding in its world and the manager's progress */
+		UFUNCTION(BlueprintCallable)
+		static UPlanetSaveGame* CaptureGame(APlanet* planet, UGameManager* manager);
+
+		UFUNCTION(BlueprintCallable)
+		static bool SaveToSlot(APlanet* planet, UGameManager* manager, const FString& slot);
+
+		UFUNCTION(BlueprintCallable)
+		static bool LoadFromSlot(APlanet* planet, UGameManager* manager, const FString& slot);
+
+		/* Regenerates the planet, replaces the placed buildings and restores progress */
+		UFUNCTION(BlueprintCallable)
+		bool Restore(APlanet* planet, UGameManager* manager);
+
+		UFUNCTION(BlueprintCallable)
+		int32 GetSeed() const { return Seed; }
+
+		UFUNCTION(BlueprintCallable)
+		int GetNumBuildings() const { return Buildings.Num(); }
+
+	private:
+		bool Valid;
+
+		int32 Seed;
+		int32 Preset;
+
+		/* Checked on load so a reordered preset list is noticed */
+		FString PresetName;
+
+		TArray<FTerrainEdit> TerrainEdits;
+		TArray<FSavedBuilding> Buildings;
+		FGameProgress Progress;
+};
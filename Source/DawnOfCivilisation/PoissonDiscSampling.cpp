@@ -3,20 +3,29 @@
 
 #include "PoissonDiscSampling.h"
 #include "SimplexNoiseBPLibrary.h"
-
-#include <algorithm>
+#include "SpatialHashGrid.h"
+#include "PoissonTileSet.h"
+#include "HAL/PlatformTime.h"
+#include "Async/ParallelFor.h"
 
 TArray<FVector2D> UPoissonDiscSampling::GeneratePoints(float radius, float regionSize, float threshold, float frequency, int numSamplesBeforeRejection)
 {
-	float cellSize = radius / sqrtf(2.0f);
+	TArray<FVector2D> points, spawnPoints;
 
-	Grid grid;
-	grid.resize(ceil(regionSize / cellSize));
+	if (radius <= 0.0f || regionSize <= 0.0f)
+		return points;
 
-	for (int y = 0; y < grid.size(); ++y)
-		grid[y].resize(ceil(regionSize / cellSize));
+	// At most one point fits in a cell of this size, so each cell stores a single index
+	float cellSize = radius / sqrtf(2.0f);
+	int32 gridSize = FMath::CeilToInt(regionSize / cellSize);
 
-	TArray<FVector2D> points, spawnPoints;
+	TArray<int32> grid;
+	grid.Init(INDEX_NONE, gridSize * gridSize);
+
+	// Roughly the packing density of a Poisson disc set
+	int32 expected = FMath::CeilToInt((regionSize * regionSize) / (radius * radius) * 0.7f);
+	points.Reserve(expected);
+	spawnPoints.Reserve(FMath::Max(expected / 8, 16));
 
 	spawnPoints.Add(FVector2D(regionSize / 2, regionSize / 2));
 
@@ -32,58 +41,185 @@ TArray<FVector2D> UPoissonDiscSampling::GeneratePoints(float radius, float regio
 			FVector2D dir(sinf(angle), cosf(angle));
 			FVector2D candidate = spawnCentre + dir * FMath::RandRange(radius, 2 * radius);
 
-			if (IsValid(candidate, regionSize, cellSize, radius, points, grid))
+			if (IsValid(candidate, regionSize, cellSize, radius, points, grid, gridSize))
 			{
-				points.Add(candidate);
+				int32 cellX = FMath::Min((int32)(candidate.X / cellSize), gridSize - 1);
+				int32 cellY = FMath::Min((int32)(candidate.Y / cellSize), gridSize - 1);
+
+				grid[cellY * gridSize + cellX] = points.Add(candidate);
 				spawnPoints.Add(candidate);
-				grid[(int)(candidate.X / cellSize)][(int)(candidate.Y / cellSize)] = points.Num();
 				candidateAccepted = true;
 				break;
 			}
 		}
 
+		// Order of the active list doesn't matter, so drop without shifting
 		if (!candidateAccepted)
-			spawnPoints.RemoveAt(spawnIndex);
+			spawnPoints.RemoveAtSwap(spawnIndex, 1, false);
 	}
 
-	for(int i = 0; i < points.Num();)
+	FilterPoints(points, regionSize, threshold, frequency);
+
+	return points;
+}
+
+void UPoissonDiscSampling::FilterPoints(TArray<FVector2D>& points, float regionSize, float threshold, float frequency)
+{
+	const FVector2D centre(regionSize / 2, regionSize / 2);
+	const float maxDistSq = (regionSize * regionSize) / 4;
+	int32 numKept = 0;
+
+	for (int32 i = 0; i < points.Num(); ++i)
 	{
-		float noise = USimplexNoiseBPLibrary::SimplexNoise2D(points[i].X * frequency, points[i].Y * frequency);
-		noise += USimplexNoiseBPLibrary::SimplexNoise2D(points[i].X * frequency * 2, points[i].Y * frequency * 2) * 0.5f;
+		const FVector2D point = points[i];
+
+		if (FVector2D::DistSquared(centre, point) > maxDistSq)
+			continue;
+
+		float noise = USimplexNoiseBPLibrary::SimplexNoise2D(point.X * frequency, point.Y * frequency);
+		noise += USimplexNoiseBPLibrary::SimplexNoise2D(point.X * frequency * 2, point.Y * frequency * 2) * 0.5f;
 		noise /= 2;
 
-		float distToCentre = FVector2D::DistSquared(FVector2D(regionSize / 2, regionSize / 2), points[i]);
+		if (noise <= threshold)
+			points[numKept++] = point;
+	}
+
+	points.SetNum(numKept, false);
+}
+
+TArray<FVector2D> UPoissonDiscSampling::GeneratePointsSeeded(float radius, float regionSize, float threshold, float frequency, int32 seed, int numSamplesBeforeRejection)
+{
+	TArray<FVector2D> points;
+
+	if (radius <= 0.0f || regionSize <= 0.0f)
+		return points;
+
+	float cellSize = radius / sqrtf(2.0f);
+	float radiusSq = radius * radius;
+	int32 gridSize = FMath::CeilToInt(regionSize / cellSize);
+
+	// Tiles are whole cells and wider than the 2 cell search band, so tiles of the same phase never share a cell
+	int32 tileCells = FMath::Max(8, gridSize / 16);
+	int32 numTiles = FMath::DivideAndRoundUp(gridSize, tileCells);
+
+	// Cells hold the point itself rather than an index, X < 0 is empty
+	TArray<FVector2D> grid;
+	grid.Init(FVector2D(-1.0f, -1.0f), gridSize * gridSize);
+
+	TArray<TArray<FVector2D>> tilePoints;
+	tilePoints.SetNum(numTiles * numTiles);
+
+	auto cellOf = [cellSize, gridSize](float v) { return FMath::Clamp((int32)(v / cellSize), 0, gridSize - 1); };
+
+	auto sampleTile = [&](int32 tx, int32 ty)
+	{
+		FRandomStream random(HashCombine(GetTypeHash(seed), HashCombine(GetTypeHash(tx), GetTypeHash(ty))));
+		TArray<FVector2D>& output = tilePoints[ty * numTiles + tx];
+		TArray<FVector2D> spawnPoints;
+
+		const int32 minCellX = tx * tileCells, maxCellX = FMath::Min(minCellX + tileCells, gridSize) - 1;
+		const int32 minCellY = ty * tileCells, maxCellY = FMath::Min(minCellY + tileCells, gridSize) - 1;
+		const FVector2D tileMin(minCellX * cellSize, minCellY * cellSize);
+		const FVector2D tileMax(FMath::Min((maxCellX + 1) * cellSize, regionSize), FMath::Min((maxCellY + 1) * cellSize, regionSize));
+
+		auto tryAdd = [&](const FVector2D& candidate)
+		{
+			if (candidate.X < tileMin.X || candidate.X >= tileMax.X || candidate.Y < tileMin.Y || candidate.Y >= tileMax.Y)
+				return false;
+
+			int32 cellX = cellOf(candidate.X), cellY = cellOf(candidate.Y);
+
+			for (int32 y = FMath::Max(0, cellY - 2); y <= FMath::Min(cellY + 2, gridSize - 1); ++y)
+			{
+				for (int32 x = FMath::Max(0, cellX - 2); x <= FMath::Min(cellX + 2, gridSize - 1); ++x)
+				{
+					const FVector2D& other = grid[y * gridSize + x];
+
+					if (other.X >= 0.0f && FVector2D::DistSquared(candidate, other) < radiusSq)
+						return false;
+				}
+			}
+
+			grid[cellY * gridSize + cellX] = candidate;
+			output.Add(candidate);
+			spawnPoints.Add(candidate);
+			return true;
+		};
+
+		// Several uniform seeds so the space left between earlier phase tiles is reached
+		for (int i = 0; i < numSamplesBeforeRejection; ++i)
+			tryAdd(FVector2D(random.FRandRange(tileMin.X, tileMax.X), random.FRandRange(tileMin.Y, tileMax.Y)));
 
-		if (distToCentre > (regionSize * regionSize) / 4 || noise > threshold )
-			points.RemoveAt(i);
-		else
-			++i;
+		while (spawnPoints.Num() > 0)
+		{
+			int32 spawnIndex = random.RandRange(0, spawnPoints.Num() - 1);
+			FVector2D spawnCentre = spawnPoints[spawnIndex];
+			bool candidateAccepted = false;
+
+			for (int i = 0; i < numSamplesBeforeRejection && !candidateAccepted; i++)
+			{
+				float angle = random.FRand() * PI * 2;
+				FVector2D dir(sinf(angle), cosf(angle));
+				candidateAccepted = tryAdd(spawnCentre + dir * random.FRandRange(radius, 2 * radius));
+			}
+
+			if (!candidateAccepted)
+				spawnPoints.RemoveAtSwap(spawnIndex, 1, false);
+		}
+	};
+
+	for (int32 phase = 0; phase < 4; ++phase)
+	{
+		const int32 phaseX = phase & 1, phaseY = phase >> 1;
+		const int32 tilesX = (numTiles - phaseX + 1) / 2;
+		const int32 tilesY = (numTiles - phaseY + 1) / 2;
+
+		ParallelFor(tilesX * tilesY, [&](int32 i)
+		{
+			sampleTile(phaseX + (i % tilesX) * 2, phaseY + (i / tilesX) * 2);
+		});
 	}
 
+	// Fixed tile order keeps the output identical however the passes were scheduled
+	int32 total = 0;
+
+	for (auto& tile : tilePoints)
+		total += tile.Num();
+
+	points.Reserve(total);
+
+	for (auto& tile : tilePoints)
+		points.Append(tile);
+
+	FilterPoints(points, regionSize, threshold, frequency);
+
 	return points;
 }
 
-bool UPoissonDiscSampling::IsValid(FVector2D candidate, float regionSize, float cellSize, float radius, TArray<FVector2D> points, Grid grid)
+bool UPoissonDiscSampling::IsValid(const FVector2D& candidate, float regionSize, float cellSize, float radius, const TArray<FVector2D>& points, const TArray<int32>& grid, int32 gridSize)
 {
 	if (candidate.X >= 0 && candidate.X < regionSize && candidate.Y >= 0 && candidate.Y < regionSize)
 	{
-		int cellX = (int)(candidate.X / cellSize);
-		int cellY = (int)(candidate.Y / cellSize);
+		int32 cellX = FMath::Min((int32)(candidate.X / cellSize), gridSize - 1);
+		int32 cellY = FMath::Min((int32)(candidate.Y / cellSize), gridSize - 1);
 
-		int searchStartX = std::max(0, cellX - 2);
-		int searchEndX = std::min(cellX + 2, (int)grid.size() - 1);
-		int searchStartY = std::max(0, cellY - 2);
-		int searchEndY = std::min(cellY + 2, (int)grid[0].size() - 1);
+		int32 searchStartX = FMath::Max(0, cellX - 2);
+		int32 searchEndX = FMath::Min(cellX + 2, gridSize - 1);
+		int32 searchStartY = FMath::Max(0, cellY - 2);
+		int32 searchEndY = FMath::Min(cellY + 2, gridSize - 1);
 
-		for (int x = searchStartX; x <= searchEndX; x++)
+		float radiusSq = radius * radius;
+
+		for (int32 y = searchStartY; y <= searchEndY; y++)
 		{
-			for (int y = searchStartY; y <= searchEndY; y++)
+			const int32* row = grid.GetData() + y * gridSize;
+
+			for (int32 x = searchStartX; x <= searchEndX; x++)
 			{
-				int pointIndex = grid[x][y] - 1;
+				int32 pointIndex = row[x];
 
-				if (pointIndex != -1)
-					if (FVector2D::DistSquared(candidate, points[pointIndex]) < radius * radius)
-						return false;
+				if (pointIndex != INDEX_NONE && FVector2D::DistSquared(candidate, points[pointIndex]) < radiusSq)
+					return false;
 			}
 		}
 
@@ -92,3 +228,243 @@ bool UPoissonDiscSampling::IsValid(FVector2D candidate, float regionSize, float
 
 	return false;
 }
+
+TArray<FVector2D> UPoissonDiscSampling::GeneratePointsFromTiles(UPoissonTileSet* tiles, float radius, float regionSize, float threshold, float frequency, int32 seed)
+{
+	TArray<FVector2D> points;
+
+	if (!tiles || !tiles->IsBuilt() || radius <= 0.0f || regionSize <= 0.0f)
+		return points;
+
+	float tileSize = radius / tiles->GetBuiltRadius();
+	int32 numTiles = FMath::CeilToInt(regionSize / tileSize);
+
+	for (int32 ty = 0; ty < numTiles; ++ty)
+	{
+		for (int32 tx = 0; tx < numTiles; ++tx)
+			tiles->AppendTile(tiles->GetVariant(tx, ty, seed), FVector2D(tx * tileSize, ty * tileSize), tileSize, points);
+	}
+
+	// The mask below already discards everything past regionSize along with the corners
+	FilterPoints(points, regionSize, threshold, frequency);
+
+	return points;
+}
+
+TArray<FVector> UPoissonDiscSampling::FillCubeFace(UPoissonTileSet* tiles, float sphereRadius, float minDistance, int face, int32 seed)
+{
+	TArray<FVector> points;
+
+	if (!tiles || !tiles->IsBuilt() || sphereRadius <= 0.0f || minDistance <= 0.0f || face < 0 || face > 5)
+		return points;
+
+	static const FVector axes[6][3] =
+	{
+		{ FVector( 1, 0, 0), FVector(0, 1, 0), FVector(0, 0, 1) },
+		{ FVector(-1, 0, 0), FVector(0, -1, 0), FVector(0, 0, 1) },
+		{ FVector(0,  1, 0), FVector(-1, 0, 0), FVector(0, 0, 1) },
+		{ FVector(0, -1, 0), FVector(1, 0, 0), FVector(0, 0, 1) },
+		{ FVector(0, 0,  1), FVector(0, 1, 0), FVector(-1, 0, 0) },
+		{ FVector(0, 0, -1), FVector(0, 1, 0), FVector(1, 0, 0) }
+	};
+
+	// A face spans PI / 2 radians, sampled in face units of [0, 1)
+	float faceRadius = (minDistance / sphereRadius) / (PI / 2);
+	float tileSize = faceRadius / tiles->GetBuiltRadius();
+	int32 numTiles = FMath::CeilToInt(1.0f / tileSize);
+
+	TArray<FVector2D> facePoints;
+
+	for (int32 ty = 0; ty < numTiles; ++ty)
+	{
+		for (int32 tx = 0; tx < numTiles; ++tx)
+			tiles->AppendTile(tiles->GetVariant(tx, ty, HashCombine(GetTypeHash(seed), GetTypeHash(face))), FVector2D(tx * tileSize, ty * tileSize), tileSize, facePoints);
+	}
+
+	points.Reserve(facePoints.Num());
+
+	for (const FVector2D& p : facePoints)
+	{
+		if (p.X >= 1.0f || p.Y >= 1.0f)
+			continue;
+
+		float u = FMath::Tan((p.X * 2.0f - 1.0f) * PI / 4);
+		float v = FMath::Tan((p.Y * 2.0f - 1.0f) * PI / 4);
+
+		points.Add((axes[face][0] + axes[face][1] * u + axes[face][2] * v).GetSafeNormal() * sphereRadius);
+	}
+
+	return points;
+}
+
+TArray<FVector> UPoissonDiscSampling::GeneratePointsOnSphere(float sphereRadius, float minDistance, FPoissonSphereFilter filter, int32 seed, int numSamplesBeforeRejection)
+{
+	if (!filter.IsBound())
+		return GeneratePointsOnSphereNative(sphereRadius, minDistance, nullptr, seed, numSamplesBeforeRejection);
+
+	return GeneratePointsOnSphereNative(sphereRadius, minDistance, [&filter](const FVector& dir) { return filter.Execute(dir); }, seed, numSamplesBeforeRejection);
+}
+
+/* Most lattice points tried as seeds for separate accepted regions */
+static const int32 MaxSphereSeeds = 4096;
+
+TArray<FVector> UPoissonDiscSampling::GeneratePointsOnSphereNative(float sphereRadius, float minDistance, const FPoissonSphereFilterFunc& filter, int32 seed, int numSamplesBeforeRejection)
+{
+	TArray<FVector> points;
+
+	if (sphereRadius <= 0.0f || minDistance <= 0.0f)
+		return points;
+
+	// Sampling happens on the unit sphere; the geodesic distance maps to an angle and a chord
+	float minAngle = FMath::Min(minDistance / sphereRadius, PI);
+	float minChord = 2.0f * FMath::Sin(minAngle / 2.0f);
+	float minChordSq = minChord * minChord;
+
+	FRandomStream random(seed);
+	FSpatialHashGrid grid(minChord);
+
+	TArray<FVector> samples;
+	TArray<int32> spawnPoints;
+
+	auto isFree = [&grid, minChord](const FVector& candidate)
+	{
+		bool tooClose = false;
+		grid.ForEachInRadius(candidate, minChord, [&tooClose](int32, const FVector&) { tooClose = true; });
+		return !tooClose;
+	};
+
+	auto accept = [&](const FVector& sample)
+	{
+		int32 index = samples.Add(sample);
+		spawnPoints.Add(index);
+		grid.Add(index, sample);
+	};
+
+	// Grows the accepted region around the current spawn points; rejected candidates never spawn, so the
+	// work follows the accepted area instead of the whole sphere
+	auto expand = [&]()
+	{
+		while (spawnPoints.Num() > 0)
+		{
+			int32 spawnIndex = random.RandRange(0, spawnPoints.Num() - 1);
+			FVector spawnCentre = samples[spawnPoints[spawnIndex]];
+			bool candidateAccepted = false;
+
+			FVector tangent, bitangent;
+			spawnCentre.FindBestAxisVectors(tangent, bitangent);
+
+			for (int i = 0; i < numSamplesBeforeRejection; i++)
+			{
+				float heading = random.FRand() * PI * 2;
+				float angle = FMath::Min(random.FRandRange(minAngle, 2 * minAngle), PI);
+
+				FVector dir = tangent * FMath::Cos(heading) + bitangent * FMath::Sin(heading);
+				FVector candidate = (spawnCentre * FMath::Cos(angle) + dir * FMath::Sin(angle)).GetSafeNormal();
+
+				if (isFree(candidate) && (!filter || filter(candidate)))
+				{
+					accept(candidate);
+					candidateAccepted = true;
+					break;
+				}
+			}
+
+			if (!candidateAccepted)
+				spawnPoints.RemoveAtSwap(spawnIndex, 1, false);
+		}
+	};
+
+	FVector first = random.GetUnitVector();
+
+	if (!filter || filter(first))
+	{
+		accept(first);
+		expand();
+	}
+
+	// Seeds every accepted region a lattice point lands in, regions narrower than the lattice spacing can be missed
+	const int32 fullCount = FMath::CeilToInt(4.0f * PI / (minAngle * minAngle));
+	const int32 numSeeds = FMath::Clamp(fullCount, 1, MaxSphereSeeds);
+	const float goldenAngle = PI * (3.0f - FMath::Sqrt(5.0f));
+
+	for (int32 i = 0; i < numSeeds; ++i)
+	{
+		// Fibonacci lattice, evenly spread over the sphere
+		float z = 1.0f - (i + 0.5f) * 2.0f / numSeeds;
+		float r = FMath::Sqrt(FMath::Max(0.0f, 1.0f - z * z));
+		FVector seedPoint(FMath::Cos(goldenAngle * i) * r, FMath::Sin(goldenAngle * i) * r, z);
+
+		if (isFree(seedPoint) && (!filter || filter(seedPoint)))
+		{
+			accept(seedPoint);
+			expand();
+		}
+	}
+
+	points.Reserve(samples.Num());
+
+	for (const FVector& sample : samples)
+		points.Add(sample * sphereRadius);
+
+	return points;
+}
+
+void UPoissonDiscSampling::BenchmarkGeneratePoints(float radius, float maxRatio, int numRuns)
+{
+	const float ratios[] = { 10.0f, 30.0f, 100.0f, 300.0f, 1000.0f };
+
+	for (float ratio : ratios)
+	{
+		if (ratio > maxRatio)
+			break;
+
+		double best = MAX_dbl;
+		int32 numPoints = 0;
+
+		for (int run = 0; run < FMath::Max(1, numRuns); ++run)
+		{
+			double begin = FPlatformTime::Seconds();
+
+			// A threshold above the noise range keeps every point, so only sampling is timed
+			numPoints = GeneratePoints(radius, radius * ratio, 2.0f, 0.0f).Num();
+			best = FMath::Min(best, FPlatformTime::Seconds() - begin);
+		}
+
+		UE_LOG(LogTemp, Warning, TEXT("Poisson ratio %.0f: %d points in %.2fms (%.3fus per point)"),
+			ratio, numPoints, best * 1000.0, numPoints > 0 ? best * 1000000.0 / numPoints : 0.0);
+	}
+}
+
+void UPoissonDiscSampling::BenchmarkTileSet(UPoissonTileSet* tiles, float radius, float maxRatio, int numRuns)
+{
+	if (!tiles || !tiles->IsBuilt())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Poisson tile benchmark needs a built tile set"));
+		return;
+	}
+
+	const float ratios[] = { 10.0f, 30.0f, 100.0f, 300.0f, 1000.0f };
+
+	for (float ratio : ratios)
+	{
+		if (ratio > maxRatio)
+			break;
+
+		double bestSampled = MAX_dbl, bestTiled = MAX_dbl;
+		int32 numSampled = 0, numTiled = 0;
+
+		for (int run = 0; run < FMath::Max(1, numRuns); ++run)
+		{
+			double begin = FPlatformTime::Seconds();
+			numSampled = GeneratePoints(radius, radius * ratio, 2.0f, 0.0f).Num();
+			bestSampled = FMath::Min(bestSampled, FPlatformTime::Seconds() - begin);
+
+			begin = FPlatformTime::Seconds();
+			numTiled = GeneratePointsFromTiles(tiles, radius, radius * ratio, 2.0f, 0.0f, run).Num();
+			bestTiled = FMath::Min(bestTiled, FPlatformTime::Seconds() - begin);
+		}
+
+		UE_LOG(LogTemp, Warning, TEXT("Poisson ratio %.0f: sampled %d points in %.2fms, tiled %d points in %.2fms (%.1fx)"),
+			ratio, numSampled, bestSampled * 1000.0, numTiled, bestTiled * 1000.0, bestTiled > 0.0 ? bestSampled / bestTiled : 0.0);
+	}
+}
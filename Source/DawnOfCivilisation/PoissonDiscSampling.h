@@ -2,12 +2,15 @@
 
 #pragma once
 
-#include <vector>
-
 #include "CoreMinimal.h"
 #include "Kismet/BlueprintFunctionLibrary.h"
 #include "PoissonDiscSampling.generated.h"
 
+/* Return false to reject a sample at the given unit direction */
+DECLARE_DYNAMIC_DELEGATE_RetVal_OneParam(bool, FPoissonSphereFilter, FVector, Direction);
+
+typedef TFunction<bool(const FVector& direction)> FPoissonSphereFilterFunc;
+
 UCLASS()
 class DAWNOFCIVILISATION_API UPoissonDiscSampling : public UBlueprintFunctionLibrary
 {
@@ -17,8 +20,53 @@ class DAWNOFCIVILISATION_API UPoissonDiscSampling : public UBlueprintFunctionLib
 		UFUNCTION(BlueprintCallable)
 		static TArray<FVector2D> GeneratePoints(float radius, float regionSize, float threshold, float frequency, int numSamplesBeforeRejection = 30);
 
+		/**
+		 * Same output density as GeneratePoints but reproducible from seed. The region is
+		 * split into tiles sampled in four phase-staggered passes; tiles within a pass are
+		 * never adjacent, so they run in parallel and the result doesn't depend on thread count.
+		 */
+		UFUNCTION(BlueprintCallable)
+		static TArray<FVector2D> GeneratePointsSeeded(float radius, float regionSize, float threshold, float frequency, int32 seed, int numSamplesBeforeRejection = 30);
+
+		/**
+		 * Fills the region by laying out precomputed tiles scaled so their spacing matches
+		 * radius, then applies the same mask and noise threshold as GeneratePoints. No
+		 * rejection sampling happens, so the cost is proportional to the output.
+		 */
+		UFUNCTION(BlueprintCallable)
+		static TArray<FVector2D> GeneratePointsFromTiles(class UPoissonTileSet* tiles, float radius, float regionSize, float threshold, float frequency, int32 seed = 0);
+
+		/**
+		 * Tiles one face (0-5) of a cube projected onto a sphere. Uses an equal-angle
+		 * mapping to keep spacing within about 30% of minDistance; faces are filled
+		 * independently so spacing isn't guaranteed across face edges.
+		 */
+		UFUNCTION(BlueprintCallable)
+		static TArray<FVector> FillCubeFace(class UPoissonTileSet* tiles, float sphereRadius, float minDistance, int face, int32 seed = 0);
+
+		/* Logs GeneratePointsFromTiles timings against GeneratePoints for the same ratios */
+		UFUNCTION(BlueprintCallable)
+		static void BenchmarkTileSet(class UPoissonTileSet* tiles, float radius = 1.0f, float maxRatio = 1000.0f, int numRuns = 3);
+
+		/**
+		 * Bridson sampling over the surface of a sphere, minDistance is measured along the
+		 * surface. Candidates failing filter are rejected while sampling and never spawn more,
+		 * so the cost follows the accepted area. Separate accepted regions are seeded from a
+		 * lattice of up to 4096 points and can be missed if narrower than its spacing.
+		 */
+		UFUNCTION(BlueprintCallable)
+		static TArray<FVector> GeneratePointsOnSphere(float sphereRadius, float minDistance, FPoissonSphereFilter filter, int32 seed = 0, int numSamplesBeforeRejection = 30);
+
+		static TArray<FVector> GeneratePointsOnSphereNative(float sphereRadius, float minDistance, const FPoissonSphereFilterFunc& filter, int32 seed = 0, int numSamplesBeforeRejection = 30);
+
+		/* Logs GeneratePoints timings for regionSize / radius ratios from 10 up to maxRatio */
+		UFUNCTION(BlueprintCallable)
+		static void BenchmarkGeneratePoints(float radius = 1.0f, float maxRatio = 1000.0f, int numRuns = 3);
+
 	private:
-		typedef std::vector<std::vector<int>> Grid;
+		/* Drops points outside the inscribed circle or above the noise threshold */
+		static void FilterPoints(TArray<FVector2D>& points, float regionSize, float threshold, float frequency);
 
-		static bool IsValid(FVector2D candidate, float regionSize, float cellSize, float radius, TArray<FVector2D> points, Grid grid);
+		/* Row-major gridSize * gridSize cells, each holding a point index or INDEX_NONE */
+		static bool IsValid(const FVector2D& candidate, float regionSize, float cellSize, float radius, const TArray<FVector2D>& points, const TArray<int32>& grid, int32 gridSize);
 };
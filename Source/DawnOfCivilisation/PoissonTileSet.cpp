@@ -0,0 +1,199 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PoissonTileSet.h"
+#include "HAL/PlatformTime.h"
+
+/* Bridson over the unit square, optionally wrapping at the edges */
+class FUnitSquareSampler
+{
+	public:
+		FUnitSquareSampler(float radius, bool wrap, float margin)
+			: RadiusSq(radius * radius), Wrap(wrap), Margin(margin)
+		{
+			// Whole number of cells so the grid wraps exactly
+			GridSize = FMath::Max(1, FMath::CeilToInt(FMath::Sqrt(2.0f) / radius));
+			Grid.Init(INDEX_NONE, GridSize * GridSize);
+		}
+
+		/* Adds a point without checking spacing, used for the shared border */
+		void AddFixed(const FVector2D& point)
+		{
+			Insert(point);
+		}
+
+		void Sample(FRandomStream& random, float radius, int numSamplesBeforeRejection)
+		{
+			TArray<int32> spawnPoints;
+
+			for (int32 i = 0; i < Points.Num(); ++i)
+				spawnPoints.Add(i);
+
+			for (int i = 0; i < numSamplesBeforeRejection; ++i)
+			{
+				FVector2D candidate(random.FRandRange(Margin, 1.0f - Margin), random.FRandRange(Margin, 1.0f - Margin));
+
+				if (IsValid(candidate))
+					spawnPoints.Add(Insert(candidate));
+			}
+
+			while (spawnPoints.Num() > 0)
+			{
+				int32 spawnIndex = random.RandRange(0, spawnPoints.Num() - 1);
+				FVector2D spawnCentre = Points[spawnPoints[spawnIndex]];
+				bool candidateAccepted = false;
+
+				for (int i = 0; i < numSamplesBeforeRejection && !candidateAccepted; i++)
+				{
+					float angle = random.FRand() * PI * 2;
+					FVector2D candidate = spawnCentre + FVector2D(sinf(angle), cosf(angle)) * random.FRandRange(radius, 2 * radius);
+
+					if (Wrap)
+						candidate = FVector2D(FMath::Frac(candidate.X), FMath::Frac(candidate.Y));
+
+					if (IsValid(candidate))
+					{
+						spawnPoints.Add(Insert(candidate));
+						candidateAccepted = true;
+					}
+				}
+
+				if (!candidateAccepted)
+					spawnPoints.RemoveAtSwap(spawnIndex, 1, false);
+			}
+		}
+
+		TArray<FVector2D> Points;
+
+	private:
+		int32 CellOf(float v) const { return FMath::Clamp((int32)(v * GridSize), 0, GridSize - 1); }
+
+		int32 Insert(const FVector2D& point)
+		{
+			int32 index = Points.Add(point);
+			Grid[CellOf(point.Y) * GridSize + CellOf(point.X)] = index;
+			return index;
+		}
+
+		bool IsValid(const FVector2D& candidate) const
+		{
+			if (candidate.X < Margin || candidate.X >= 1.0f - Margin || candidate.Y < Margin || candidate.Y >= 1.0f - Margin)
+				return false;
+
+			int32 cellX = CellOf(candidate.X), cellY = CellOf(candidate.Y);
+
+			for (int32 dy = -2; dy <= 2; ++dy)
+			{
+				for (int32 dx = -2; dx <= 2; ++dx)
+				{
+					int32 x = cellX + dx, y = cellY + dy;
+
+					if (Wrap)
+						x = (x + GridSize) % GridSize, y = (y + GridSize) % GridSize;
+					else if (x < 0 || y < 0 || x >= GridSize || y >= GridSize)
+						continue;
+
+					int32 index = Grid[y * GridSize + x];
+
+					if (index == INDEX_NONE)
+						continue;
+
+					FVector2D delta = Points[index] - candidate;
+
+					if (Wrap)
+						delta = FVector2D(delta.X - FMath::RoundToFloat(delta.X), delta.Y - FMath::RoundToFloat(delta.Y));
+
+					if (delta.SizeSquared() < RadiusSq)
+						return false;
+				}
+			}
+
+			return true;
+		}
+
+		float RadiusSq;
+		bool Wrap;
+		float Margin;
+		int32 GridSize;
+		TArray<int32> Grid;
+};
+
+UPoissonTileSet::UPoissonTileSet()
+	: RelativeRadius(0.025f),
+	  NumVariants(8),
+	  Seed(0),
+	  NumSamplesBeforeRejection(30),
+	  BuiltRadius(0.0f)
+{
+}
+
+void UPoissonTileSet::Build()
+{
+	double begin = FPlatformTime::Seconds();
+
+	// Past a quarter of the tile there is no interior left to vary
+	float radius = FMath::Clamp(RelativeRadius, 0.002f, 0.25f);
+	float band = radius * 2.0f;
+
+	FRandomStream random(Seed);
+	FUnitSquareSampler base(radius, true, 0.0f);
+	base.Sample(random, radius, NumSamplesBeforeRejection);
+
+	// Border points are more than the radius from anything a neighbour adds inside its own band
+	TArray<FVector2D> border;
+
+	for (const FVector2D& p : base.Points)
+	{
+		if (FMath::Min(FMath::Min(p.X, 1.0f - p.X), FMath::Min(p.Y, 1.0f - p.Y)) < band)
+			border.Add(p);
+	}
+
+	Points.Reset();
+	VariantOffsets.Reset();
+	VariantOffsets.Add(0);
+
+	for (int32 variant = 0; variant < FMath::Max(1, NumVariants); ++variant)
+	{
+		FRandomStream variantRandom(HashCombine(GetTypeHash(Seed), GetTypeHash(variant + 1)));
+		FUnitSquareSampler sampler(radius, false, band);
+
+		for (const FVector2D& p : border)
+			sampler.AddFixed(p);
+
+		sampler.Sample(variantRandom, radius, NumSamplesBeforeRejection);
+
+		for (const FVector2D& p : sampler.Points)
+		{
+			Points.Add((uint16)FMath::Clamp(FMath::FloorToInt(p.X * 65536.0f), 0, 65535));
+			Points.Add((uint16)FMath::Clamp(FMath::FloorToInt(p.Y * 65536.0f), 0, 65535));
+		}
+
+		VariantOffsets.Add(Points.Num() / 2);
+	}
+
+	BuiltRadius = radius;
+	MarkPackageDirty();
+
+	UE_LOG(LogTemp, Log, TEXT("Built %d Poisson tiles (%d points) in %.2fms"), GetNumBuiltVariants(), Points.Num() / 2, (FPlatformTime::Seconds() - begin) * 1000.0);
+}
+
+int32 UPoissonTileSet::GetVariant(int32 tx, int32 ty, int32 seed) const
+{
+	uint32 hash = HashCombine(GetTypeHash(seed), HashCombine(GetTypeHash(tx), GetTypeHash(ty)));
+
+	// Murmur finaliser, neighbouring coordinates otherwise pick correlated variants
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6b;
+	hash ^= hash >> 13;
+
+	return (int32)(hash % (uint32)GetNumBuiltVariants());
+}
+
+void UPoissonTileSet::AppendTile(int32 variant, const FVector2D& origin, float tileSize, TArray<FVector2D>& points) const
+{
+	const float scale = tileSize / 65536.0f;
+	const uint16* data = Points.GetData();
+
+	for (int32 i = VariantOffsets[variant]; i < VariantOffsets[variant + 1]; ++i)
+		points.Add(FVector2D(origin.X + (data[i * 2] + 0.5f) * scale, origin.Y + (data[i * 2 + 1] + 0.5f) * scale));
+}
@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "PoissonTileSet.generated.h"
+
+/**
+ * Precomputed Poisson disc tiles over the unit square. Every variant shares the
+ * border band of one toroidal base tile and has its own interior, so any two
+ * variants can sit next to each other and the minimum distance still holds
+ * across the seam. Points are stored quantised to 16 bits per axis.
+ */
+UCLASS(BlueprintType)
+class DAWNOFCIVILISATION_API UPoissonTileSet : public UDataAsset
+{
+	GENERATED_BODY()
+
+	public:
+		UPoissonTileSet();
+
+		/* Minimum distance between points as a fraction of the tile size */
+		UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Generation")
+		float RelativeRadius;
+
+		UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Generation")
+		int32 NumVariants;
+
+		UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Generation")
+		int32 Seed;
+
+		UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Generation")
+		int32 NumSamplesBeforeRejection;
+
+		/* Regenerates every variant from the generation settings */
+		UFUNCTION(CallInEditor, BlueprintCallable, Category = "Generation")
+		void Build();
+
+		/* Radius the stored tiles were built with, in tile units */
+		float GetBuiltRadius() const { return BuiltRadius; }
+
+		bool IsBuilt() const { return VariantOffsets.Num() > 1; }
+		int32 GetNumBuiltVariants() const { return VariantOffsets.Num() - 1; }
+
+		/* Stable variant for a tile coordinate */
+		int32 GetVariant(int32 tx, int32 ty, int32 seed) const;
+
+		/* Appends the variant's points scaled by tileSize and offset by origin */
+		void AppendTile(int32 variant, const FVector2D& origin, float tileSize, TArray<FVector2D>& points) const;
+
+	private:
+		/* Interleaved x, y pairs; variant i owns pairs [VariantOffsets[i], VariantOffsets[i + 1]) */
+		UPROPERTY()
+		TArray<uint16> Points;
+
+		UPROPERTY()
+		TArray<int32> VariantOffsets;
+
+		UPROPERTY()
+		float BuiltRadius;
+};
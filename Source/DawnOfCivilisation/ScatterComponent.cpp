@@ -0,0 +1,171 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ScatterComponent.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+
+UScatterComponent::UScatterComponent()
+	: NextId(0)
+{
+	PrimaryComponentTick.bCanEverTick = false;
+}
+
+int32 UScatterComponent::FindType(FName type) const
+{
+	return MeshTypes.IndexOfByPredicate([type](const FScatterMeshType& t) { return t.Name == type; });
+}
+
+UHierarchicalInstancedStaticMeshComponent* UScatterComponent::GetOrCreateComponent(int32 type)
+{
+	if (Components.Num() < MeshTypes.Num())
+	{
+		Components.SetNumZeroed(MeshTypes.Num());
+		InstanceIds.SetNum(MeshTypes.Num());
+	}
+
+	if (Components[type])
+		return Components[type];
+
+	const FScatterMeshType& settings = MeshTypes[type];
+
+	auto component = NewObject<UHierarchicalInstancedStaticMeshComponent>(GetOwner(), NAME_None, RF_Transient);
+	component->SetStaticMesh(settings.Mesh);
+	component->SetCullDistances(settings.CullStart, settings.CullEnd);
+	component->SetCastShadow(settings.CastShadow);
+	component->SetCollisionProfileName(TEXT("BlockAll"));
+
+	// Trees are rebuilt once per batch instead of once per instance
+	component->bAutoRebuildTreeOnInstanceChanges = false;
+
+	component->SetupAttachment(this);
+	component->RegisterComponent();
+
+	Components[type] = component;
+
+	return component;
+}
+
+int UScatterComponent::AddInstances(FName type, const TArray<FVector>& positions, const TArray<FVector>& normals, TArray<int>& ids, int32 seed)
+{
+	int32 typeIndex = FindType(type);
+
+	if (typeIndex == INDEX_NONE || !MeshTypes[typeIndex].Mesh)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Unknown scatter type %s"), *type.ToString());
+		return 0;
+	}
+
+	const FScatterMeshType& settings = MeshTypes[typeIndex];
+	auto component = GetOrCreateComponent(typeIndex);
+	auto& instanceIds = InstanceIds[typeIndex];
+
+	FRandomStream random(seed);
+	FVector centre = GetOwner() ? GetOwner()->GetActorLocation() : FVector::ZeroVector;
+
+	ids.Reserve(ids.Num() + positions.Num());
+	instanceIds.Reserve(instanceIds.Num() + positions.Num());
+	Instances.Reserve(Instances.Num() + positions.Num());
+
+	for (int32 i = 0; i < positions.Num(); ++i)
+	{
+		FVector up = normals.IsValidIndex(i) ? normals[i] : (positions[i] - centre);
+		up = up.GetSafeNormal(SMALL_NUMBER, FVector::UpVector);
+
+		// Random yaw around the surface normal
+		FQuat rotation = FQuat::FindBetweenNormals(FVector::UpVector, up) * FQuat(FVector::UpVector, random.FRand() * PI * 2);
+		FVector scale(random.FRandRange(settings.MinScale, settings.MaxScale));
+
+		int32 index = component->AddInstanceWorldSpace(FTransform(rotation, positions[i], scale));
+		int32 id = NextId++;
+
+		check(index == instanceIds.Num());
+
+		instanceIds.Add(id);
+		Instances.Add(id, { typeIndex, index });
+		ids.Add(id);
+	}
+
+	component->BuildTreeIfOutdated(true, false);
+
+	return positions.Num();
+}
+
+int UScatterComponent::RemoveInstances(const TArray<int>& ids)
+{
+	TArray<TArray<int32>> indices;
+	indices.SetNum(Components.Num());
+
+	for (int id : ids)
+	{
+		FScatterInstanceRef ref;
+
+		if (Instances.RemoveAndCopyValue(id, ref))
+			indices[ref.Type].Add(ref.Index);
+	}
+
+	int removed = 0;
+
+	for (int32 type = 0; type < indices.Num(); ++type)
+	{
+		if (indices[type].Num() == 0)
+			continue;
+
+		auto component = Components[type];
+		auto& instanceIds = InstanceIds[type];
+
+		// Highest first so no index we still have to remove gets swapped into a removed slot
+		indices[type].Sort([](int32 a, int32 b) { return a > b; });
+
+		for (int32 index : indices[type])
+		{
+			// HISM fills the hole with its last instance, so the mirror does the same
+			component->RemoveInstance(index);
+			instanceIds.RemoveAtSwap(index, 1, false);
+
+			if (index < instanceIds.Num())
+				Instances[instanceIds[index]].Index = index;
+
+			++removed;
+		}
+
+		component->BuildTreeIfOutdated(true, false);
+	}
+
+	return removed;
+}
+
+void UScatterComponent::ClearInstances()
+{
+	for (auto component : Components)
+	{
+		if (component)
+			component->ClearInstances();
+	}
+
+	for (auto& instanceIds : InstanceIds)
+		instanceIds.Reset();
+
+	Instances.Reset();
+}
+
+FName UScatterComponent::GetInstanceType(int id) const
+{
+	auto ref = Instances.Find(id);
+	return ref ? MeshTypes[ref->Type].Name : NAME_None;
+}
+
+bool UScatterComponent::GetInstanceTransform(int id, FTransform& transform) const
+{
+	auto ref = Instances.Find(id);
+	return ref && Components[ref->Type]->GetInstanceTransform(ref->Index, transform, true);
+}
+
+int UScatterComponent::GetInstanceFromHit(UPrimitiveComponent* component, int item) const
+{
+	int32 type = Components.IndexOfByKey(component);
+
+	if (type == INDEX_NONE || !InstanceIds[type].IsValidIndex(item))
+		return INDEX_NONE;
+
+	return InstanceIds[type][item];
+}
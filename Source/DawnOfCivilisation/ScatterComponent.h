@@ -0,0 +1,102 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/SceneComponent.h"
+#include "ScatterComponent.generated.h"
+
+class UHierarchicalInstancedStaticMeshComponent;
+
+USTRUCT(BlueprintType)
+struct FScatterMeshType
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FName Name;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	UStaticMesh* Mesh;
+
+	/* Instances start fading at CullStart and are gone by CullEnd, 0 never culls */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float CullStart;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float CullEnd;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float MinScale;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float MaxScale;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool CastShadow;
+
+	FScatterMeshType() : Mesh(NULL), CullStart(0.0f), CullEnd(0.0f), MinScale(1.0f), MaxScale(1.0f), CastShadow(true) {}
+};
+
+struct FScatterInstanceRef
+{
+	int32 Type;
+	int32 Index;
+};
+
+/**
+ * Draws scattered props (trees, rocks, grass) as one hierarchical instanced
+ * mesh per type instead of an actor each. Instances are addressed by stable
+ * ids that survive the index shuffling HISM does on removal.
+ */
+UCLASS(ClassGroup = (Custom), meta = (BlueprintSpawnableComponent))
+class DAWNOFCIVILISATION_API UScatterComponent : public USceneComponent
+{
+	GENERATED_BODY()
+
+	public:
+		UScatterComponent();
+
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Scatter")
+		TArray<FScatterMeshType> MeshTypes;
+
+		/* Adds one instance per position with its up axis along the matching normal (or away from the owner if none), returns how many were added */
+		UFUNCTION(BlueprintCallable)
+		int AddInstances(FName type, const TArray<FVector>& positions, const TArray<FVector>& normals, TArray<int>& ids, int32 seed = 0);
+
+		UFUNCTION(BlueprintCallable)
+		int RemoveInstances(const TArray<int>& ids);
+
+		UFUNCTION(BlueprintCallable)
+		void ClearInstances();
+
+		UFUNCTION(BlueprintCallable)
+		bool IsValidInstance(int id) const { return Instances.Contains(id); }
+
+		UFUNCTION(BlueprintCallable)
+		FName GetInstanceType(int id) const;
+
+		UFUNCTION(BlueprintCallable)
+		bool GetInstanceTransform(int id, FTransform& transform) const;
+
+		/* Id of the instance behind a trace hit on one of the scatter meshes, -1 if it isn't one */
+		UFUNCTION(BlueprintCallable)
+		int GetInstanceFromHit(UPrimitiveComponent* component, int item) const;
+
+		UFUNCTION(BlueprintCallable)
+		int GetNumInstances() const { return Instances.Num(); }
+
+	private:
+		int32 FindType(FName type) const;
+		UHierarchicalInstancedStaticMeshComponent* GetOrCreateComponent(int32 type);
+
+		/* One per entry in MeshTypes, created on first use */
+		UPROPERTY()
+		TArray<UHierarchicalInstancedStaticMeshComponent*> Components;
+
+		/* Instance index -> id for each component, kept in the same order as the HISM */
+		TArray<TArray<int32>> InstanceIds;
+
+		TMap<int32, FScatterInstanceRef> Instances;
+		int32 NextId;
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Sparse uniform grid over 3D points. Only cells that contain points are
+ * allocated, so bucketing points on a sphere's surface costs memory
+ * proportional to the surface rather than the enclosing volume.
+ */
+class DAWNOFCIVILISATION_API FSpatialHashGrid
+{
+	public:
+		FSpatialHashGrid(float cellSize = 100.0f) { Reset(cellSize); }
+
+		void Reset(float cellSize)
+		{
+			CellSize = FMath::Max(cellSize, KINDA_SMALL_NUMBER);
+			InvCellSize = 1.0f / CellSize;
+			Cells.Reset();
+		}
+
+		float GetCellSize() const { return CellSize; }
+
+		void Add(int32 item, const FVector& pos)
+		{
+			Cells.FindOrAdd(CellOf(pos)).Add(FItem(item, pos));
+		}
+
+		void Remove(int32 item, const FVector& pos)
+		{
+			auto cell = Cells.Find(CellOf(pos));
+
+			if (cell)
+				cell->RemoveAllSwap([item](const FItem& i) { return i.Item == item; });
+		}
+
+		/* Calls func(item, position) for every point strictly within radius of centre */
+		template <typename FuncType>
+		void ForEachInRadius(const FVector& centre, float radius, FuncType func) const
+		{
+			FIntVector min = CellOf(centre - FVector(radius));
+			FIntVector max = CellOf(centre + FVector(radius));
+			float r2 = radius * radius;
+
+			int64 boxCells = (int64)(max.X - min.X + 1) * (max.Y - min.Y + 1) * (max.Z - min.Z + 1);
+
+			// A large radius covers more cells than are occupied, walking the occupied ones is cheaper
+			if (boxCells > Cells.Num())
+			{
+				for (auto& cell : Cells)
+				{
+					for (const FItem& i : cell.Value)
+					{
+						if (FVector::DistSquared(i.Position, centre) < r2)
+							func(i.Item, i.Position);
+					}
+				}
+
+				return;
+			}
+
+			for (int32 x = min.X; x <= max.X; ++x)
+			{
+				for (int32 y = min.Y; y <= max.Y; ++y)
+				{
+					for (int32 z = min.Z; z <= max.Z; ++z)
+					{
+						auto cell = Cells.Find(FIntVector(x, y, z));
+
+						if (!cell)
+							continue;
+
+						for (const FItem& i : *cell)
+						{
+							if (FVector::DistSquared(i.Position, centre) < r2)
+								func(i.Item, i.Position);
+						}
+					}
+				}
+			}
+		}
+
+	private:
+		struct FItem
+		{
+			int32 Item;
+			FVector Position;
+
+			FItem(int32 item, const FVector& pos) : Item(item), Position(pos) {}
+		};
+
+		FIntVector CellOf(const FVector& pos) const
+		{
+			return FIntVector(FMath::FloorToInt(pos.X * InvCellSize), FMath::FloorToInt(pos.Y * InvCellSize), FMath::FloorToInt(pos.Z * InvCellSize));
+		}
+
+		float CellSize;
+		float InvCellSize;
+		TMap<FIntVector, TArray<FItem, TInlineAllocator<4>>> Cells;
+};